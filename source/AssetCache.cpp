@@ -0,0 +1,205 @@
+#include "pch.h"
+#include "AssetCache.h"
+#include "Texture.h"
+#include "Effect.h"
+#include "Mesh.h"
+
+
+dae::AssetCache::AssetCache(ID3D11Device* pDevice)
+	:m_pDevice{ pDevice }
+{
+}
+
+dae::AssetCache::~AssetCache()
+{
+	//Whatever was never released, meshes first since they reference the other assets
+	for (Mesh* pMesh : m_Meshes.GetAssets())
+		delete pMesh;
+
+	for (Effect* pEffect : m_Effects.GetAssets())
+		delete pEffect;
+
+	for (Texture* pTexture : m_Textures.GetAssets())
+		delete pTexture;
+}
+
+dae::Texture* dae::AssetCache::LoadTexture(const std::string& path, TextureContainer::Format format)
+{
+	const std::string key{ path + '|' + std::to_string(static_cast<uint32_t>(format)) };
+
+	{
+		std::lock_guard<std::mutex> lock{ m_Mutex };
+
+		if (Texture* pTexture{ m_Textures.Acquire(key) })
+			return pTexture;
+	}
+
+	TextureContainer* pContainer{ Texture::LoadContainer(path, format) };
+
+	if (!pContainer)
+		return nullptr;
+
+	//A copy of an image that is already resident never gets GPU resources of its own
+	{
+		std::lock_guard<std::mutex> lock{ m_Mutex };
+
+		if (Texture* pLoadedTexture{ AcquireSameContent(key, *pContainer) })
+		{
+			delete pContainer;
+			return pLoadedTexture;
+		}
+	}
+
+	Texture* pTexture{ new Texture(m_pDevice, pContainer) };
+
+	std::lock_guard<std::mutex> lock{ m_Mutex };
+
+	//Another thread loaded the same path or image in the meantime
+	Texture* pLoadedTexture{ m_Textures.Acquire(key) };
+
+	if (!pLoadedTexture)
+		pLoadedTexture = AcquireSameContent(key, *pContainer);
+
+	if (pLoadedTexture)
+	{
+		delete pTexture;
+		return pLoadedTexture;
+	}
+
+	//On a collision with a different image the first one keeps the slot, this one is just not shared by content
+	m_pTexturesByContent.try_emplace(pContainer->GetContentHash(), pTexture);
+	m_Textures.Add(key, pTexture);
+
+	return pTexture;
+}
+
+dae::Texture* dae::AssetCache::AcquireSameContent(const std::string& key, const TextureContainer& container)
+{
+	const auto contentIt{ m_pTexturesByContent.find(container.GetContentHash()) };
+
+	if (contentIt == m_pTexturesByContent.end() || !contentIt->second->GetContainer()->HasSameContent(container))
+		return nullptr;
+
+	m_Textures.Add(key, contentIt->second);
+	return contentIt->second;
+}
+
+dae::Mesh* dae::AssetCache::LoadMesh(const std::string& objFilePath, Effect* pEffect, Mesh::VertexFormat vertexFormat)
+{
+	const std::string key{ objFilePath + '|' + std::to_string(reinterpret_cast<uintptr_t>(pEffect)) + '|' + std::to_string(static_cast<int>(vertexFormat)) };
+
+	Mesh* pLoadedMesh{ nullptr };
+
+	{
+		std::lock_guard<std::mutex> lock{ m_Mutex };
+		pLoadedMesh = m_Meshes.Acquire(key);
+	}
+
+	if (!pLoadedMesh)
+	{
+		Mesh* pMesh{ new Mesh{ m_pDevice, objFilePath, pEffect, vertexFormat } };
+
+		std::lock_guard<std::mutex> lock{ m_Mutex };
+
+		//Another thread may have built the same mesh in the meantime
+		pLoadedMesh = m_Meshes.Acquire(key);
+
+		if (!pLoadedMesh)
+		{
+			m_Meshes.Add(key, pMesh);
+			return pMesh;
+		}
+
+		delete pMesh;
+	}
+
+	//The cached mesh already holds a reference to this effect
+	Release(pEffect);
+	return pLoadedMesh;
+}
+
+std::future<dae::Texture*> dae::AssetCache::LoadTextureAsync(const std::string& path, TextureContainer::Format format)
+{
+	return std::async(std::launch::async, [this, path, format]()
+		{
+			Texture* pTexture{ LoadTexture(path, format) };
+			NotifyLoaded();
+
+			return pTexture;
+		});
+}
+
+void dae::AssetCache::NotifyLoaded()
+{
+	//SDL_PushEvent may be called from any thread
+	SDL_Event event{};
+	event.type = SDL_USEREVENT;
+	SDL_PushEvent(&event);
+}
+
+void dae::AssetCache::SetMeshMap(Mesh* pMesh, void (Mesh::*setMap)(Texture*), Texture* (Mesh::*getMap)() const, Texture* pMap)
+{
+	Texture* pReplacedMap{ (pMesh->*getMap)() };
+
+	(pMesh->*setMap)(pMap);
+
+	Release(pReplacedMap);
+}
+
+void dae::AssetCache::Release(Texture* pTexture)
+{
+	if (!pTexture)
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock{ m_Mutex };
+
+		if (!m_Textures.Release(pTexture))
+			return;
+
+		const auto contentIt{ m_pTexturesByContent.find(pTexture->GetContainer()->GetContentHash()) };
+
+		if (contentIt != m_pTexturesByContent.end() && contentIt->second == pTexture)
+			m_pTexturesByContent.erase(contentIt);
+	}
+
+	delete pTexture;
+}
+
+void dae::AssetCache::Release(Effect* pEffect)
+{
+	if (!pEffect)
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock{ m_Mutex };
+
+		if (!m_Effects.Release(pEffect))
+			return;
+	}
+
+	delete pEffect;
+}
+
+void dae::AssetCache::Release(Mesh* pMesh)
+{
+	if (!pMesh)
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock{ m_Mutex };
+
+		if (!m_Meshes.Release(pMesh))
+			return;
+	}
+
+	Texture* pMaps[4]{ pMesh->GetDiffuseMap(), pMesh->GetNormalMap(), pMesh->GetSpecularMap(), pMesh->GetGlossinessMap() };
+	Effect* pEffect{ pMesh->GetEffect() };
+
+	delete pMesh;
+
+	for (Texture* pMap : pMaps)
+		Release(pMap);
+
+	Release(pEffect);
+}
@@ -0,0 +1,189 @@
+#pragma once
+#include <future>
+#include <mutex>
+#include <string>
+#include <typeinfo>
+#include <unordered_map>
+#include <vector>
+
+#include "TextureContainer.h"
+#include "Mesh.h"
+
+
+namespace dae
+{
+	class Texture;
+	class Effect;
+	class Mesh;
+
+	// Loads every asset once per key and hands out the same pointer on later loads
+	// Every Load is matched by one Release, an asset is destroyed together with its last reference
+	// Loads and releases can come from any thread, files are decoded and parsed outside the lock
+	class AssetCache final
+	{
+	public:
+		explicit AssetCache(ID3D11Device* pDevice);
+		~AssetCache();
+
+		AssetCache(const AssetCache&) = delete;
+		AssetCache(AssetCache&&) noexcept = delete;
+		AssetCache& operator=(const AssetCache&) = delete;
+		AssetCache& operator=(AssetCache&&) noexcept = delete;
+
+		// Keyed by path and format, files with identical pixels share one texture, even under different paths
+		Texture* LoadTexture(const std::string& path, TextureContainer::Format format = TextureContainer::Format::RGBA8);
+
+		// Keyed by path and effect type, the same .fx can back different effect classes
+		template <typename EffectType>
+		EffectType* LoadEffect(const std::wstring& path);
+
+		// Keyed by path, effect and vertex format, the mesh takes over the reference to pEffect
+		// The maps set on a mesh are references it owns as well, they are released with it
+		Mesh* LoadMesh(const std::string& objFilePath, Effect* pEffect, Mesh::VertexFormat vertexFormat = Mesh::VertexFormat::Full);
+
+		// Same as the loads above on a worker thread, every future has to be resolved before the cache is destroyed
+		// A finished load pushes an SDL_USEREVENT, so a main loop waiting for events wakes up to show it
+		std::future<Texture*> LoadTextureAsync(const std::string& path, TextureContainer::Format format = TextureContainer::Format::RGBA8);
+
+		// Loads the effect and then the mesh on one worker thread
+		template <typename EffectType>
+		std::future<Mesh*> LoadMeshAsync(const std::string& objFilePath, const std::wstring& effectPath, Mesh::VertexFormat vertexFormat = Mesh::VertexFormat::Full);
+
+		// Puts pMap on the mesh with one of its map setters, the mesh takes over the reference and the map it had is released
+		void SetMeshMap(Mesh* pMesh, void (Mesh::*setMap)(Texture*), Texture* (Mesh::*getMap)() const, Texture* pMap);
+
+		// Pointers the cache did not hand out are ignored
+		void Release(Texture* pTexture);
+		void Release(Effect* pEffect);
+		void Release(Mesh* pMesh);
+
+	private:
+
+		static void NotifyLoaded();
+
+		// Several keys can point at one asset, the reference count is per asset
+		template <typename AssetType, typename KeyType = std::string>
+		class AssetTable final
+		{
+		public:
+
+			// Adds a reference to the asset stored under key, nullptr when there is none
+			AssetType* Acquire(const KeyType& key)
+			{
+				const auto it{ m_pAssetsByKey.find(key) };
+
+				if (it == m_pAssetsByKey.end())
+					return nullptr;
+
+				++m_Entries[it->second].refCount;
+				return it->second;
+			}
+
+			// Stores a new reference to pAsset under key, which may already be stored under other keys
+			void Add(const KeyType& key, AssetType* pAsset)
+			{
+				Entry& entry{ m_Entries[pAsset] };
+
+				++entry.refCount;
+				entry.keys.emplace_back(key);
+
+				m_pAssetsByKey[key] = pAsset;
+			}
+
+			// Drops one reference, true when it was the last one and the asset has to be destroyed
+			bool Release(AssetType* pAsset)
+			{
+				const auto it{ m_Entries.find(pAsset) };
+
+				if (it == m_Entries.end() || --it->second.refCount > 0)
+					return false;
+
+				for (const KeyType& key : it->second.keys)
+					m_pAssetsByKey.erase(key);
+
+				m_Entries.erase(it);
+				return true;
+			}
+
+			std::vector<AssetType*> GetAssets() const
+			{
+				std::vector<AssetType*> pAssets{};
+				pAssets.reserve(m_Entries.size());
+
+				for (const auto& [pAsset, entry] : m_Entries)
+					pAssets.emplace_back(pAsset);
+
+				return pAssets;
+			}
+
+		private:
+
+			struct Entry
+			{
+				int refCount{};
+				std::vector<KeyType> keys{};
+			};
+
+			std::unordered_map<KeyType, AssetType*> m_pAssetsByKey{};
+			std::unordered_map<AssetType*, Entry> m_Entries{};
+		};
+
+
+		ID3D11Device* m_pDevice{ nullptr };
+
+		// Guards the tables only, never held while a file is loaded
+		std::mutex m_Mutex{};
+
+		AssetTable<Texture> m_Textures{};
+		AssetTable<Effect, std::wstring> m_Effects{};
+		AssetTable<Mesh> m_Meshes{};
+
+		// Content hash -> texture, to catch the same image stored under different paths
+		std::unordered_map<uint64_t, Texture*> m_pTexturesByContent{};
+
+		// A resident texture with exactly the same content, with a reference added and stored under key
+		Texture* AcquireSameContent(const std::string& key, const TextureContainer& container);
+	};
+
+
+	template <typename EffectType>
+	EffectType* AssetCache::LoadEffect(const std::wstring& path)
+	{
+		const char* typeName{ typeid(EffectType).name() };
+		const std::wstring key{ path + L'|' + std::wstring(typeName, typeName + std::char_traits<char>::length(typeName)) };
+
+		{
+			std::lock_guard<std::mutex> lock{ m_Mutex };
+
+			if (Effect* pEffect{ m_Effects.Acquire(key) })
+				return static_cast<EffectType*>(pEffect);
+		}
+
+		EffectType* pEffect{ new EffectType(m_pDevice, path) };
+
+		std::lock_guard<std::mutex> lock{ m_Mutex };
+
+		//Another thread compiled the same effect in the meantime
+		if (Effect* pLoadedEffect{ m_Effects.Acquire(key) })
+		{
+			delete pEffect;
+			return static_cast<EffectType*>(pLoadedEffect);
+		}
+
+		m_Effects.Add(key, pEffect);
+
+		return pEffect;
+	}
+
+	template <typename EffectType>
+	std::future<Mesh*> AssetCache::LoadMeshAsync(const std::string& objFilePath, const std::wstring& effectPath, Mesh::VertexFormat vertexFormat)
+	{
+		return std::async(std::launch::async, [this, objFilePath, effectPath, vertexFormat]()
+			{
+				Mesh* pMesh{ LoadMesh(objFilePath, LoadEffect<EffectType>(effectPath), vertexFormat) };
+				NotifyLoaded();
+
+				return pMesh;
+			});
+	}
+}
@@ -0,0 +1,305 @@
+#include "pch.h"
+#include "BlockCompression.h"
+
+#include <climits>
+#include <cmath>
+
+
+namespace
+{
+	uint8_t GetChannel(uint32_t texel, int channel)
+	{
+		return static_cast<uint8_t>(texel >> (channel * 8));
+	}
+
+	uint32_t MakeTexel(uint32_t r, uint32_t g, uint32_t b, uint32_t a)
+	{
+		return r | (g << 8) | (b << 16) | (a << 24);
+	}
+
+	uint16_t To565(float r, float g, float b)
+	{
+		const uint32_t r5{ static_cast<uint32_t>(std::clamp(r, 0.f, 255.f) * 31.f / 255.f + 0.5f) };
+		const uint32_t g6{ static_cast<uint32_t>(std::clamp(g, 0.f, 255.f) * 63.f / 255.f + 0.5f) };
+		const uint32_t b5{ static_cast<uint32_t>(std::clamp(b, 0.f, 255.f) * 31.f / 255.f + 0.5f) };
+
+		return static_cast<uint16_t>((r5 << 11) | (g6 << 5) | b5);
+	}
+
+	//The top bits are repeated in the low ones, so 31 and 63 expand to 255
+	void From565(uint16_t color, uint32_t rgb[3])
+	{
+		const uint32_t r5{ (color >> 11) & 31u };
+		const uint32_t g6{ (color >> 5) & 63u };
+		const uint32_t b5{ color & 31u };
+
+		rgb[0] = (r5 << 3) | (r5 >> 2);
+		rgb[1] = (g6 << 2) | (g6 >> 4);
+		rgb[2] = (b5 << 3) | (b5 >> 2);
+	}
+
+	void BuildColorPalette(uint16_t color0, uint16_t color1, bool hasTransparentIndex, uint32_t palette[4])
+	{
+		uint32_t rgb0[3]{}, rgb1[3]{};
+		From565(color0, rgb0);
+		From565(color1, rgb1);
+
+		palette[0] = MakeTexel(rgb0[0], rgb0[1], rgb0[2], 255);
+		palette[1] = MakeTexel(rgb1[0], rgb1[1], rgb1[2], 255);
+
+		if (!hasTransparentIndex)
+		{
+			palette[2] = MakeTexel((2 * rgb0[0] + rgb1[0]) / 3, (2 * rgb0[1] + rgb1[1]) / 3, (2 * rgb0[2] + rgb1[2]) / 3, 255);
+			palette[3] = MakeTexel((rgb0[0] + 2 * rgb1[0]) / 3, (rgb0[1] + 2 * rgb1[1]) / 3, (rgb0[2] + 2 * rgb1[2]) / 3, 255);
+		}
+		else
+		{
+			palette[2] = MakeTexel((rgb0[0] + rgb1[0]) / 2, (rgb0[1] + rgb1[1]) / 2, (rgb0[2] + rgb1[2]) / 2, 255);
+			palette[3] = 0;
+		}
+	}
+
+	void BuildChannelPalette(uint8_t value0, uint8_t value1, uint32_t palette[8])
+	{
+		palette[0] = value0;
+		palette[1] = value1;
+
+		//8 values when the first endpoint is larger, otherwise 6 plus the extremes
+		if (value0 > value1)
+		{
+			for (uint32_t i{ 1 }; i < 7; ++i)
+				palette[i + 1] = ((7 - i) * value0 + i * value1) / 7;
+		}
+		else
+		{
+			for (uint32_t i{ 1 }; i < 5; ++i)
+				palette[i + 1] = ((5 - i) * value0 + i * value1) / 5;
+
+			palette[6] = 0;
+			palette[7] = 255;
+		}
+	}
+
+	//Four color mode only, the endpoints go along the largest spread of the colors
+	void EncodeColorBlock(const uint32_t texels[16], uint8_t* pBlock)
+	{
+		float mean[3]{};
+
+		for (int i{}; i < 16; ++i)
+		{
+			for (int channel{}; channel < 3; ++channel)
+				mean[channel] += GetChannel(texels[i], channel) / 16.f;
+		}
+
+		float covariance[3][3]{};
+
+		for (int i{}; i < 16; ++i)
+		{
+			float offset[3]{};
+
+			for (int channel{}; channel < 3; ++channel)
+				offset[channel] = GetChannel(texels[i], channel) - mean[channel];
+
+			for (int row{}; row < 3; ++row)
+			{
+				for (int column{}; column < 3; ++column)
+					covariance[row][column] += offset[row] * offset[column];
+			}
+		}
+
+		//A few power iterations are plenty for a 3x3 matrix
+		float axis[3]{ 1.f, 1.f, 1.f };
+
+		for (int iteration{}; iteration < 8; ++iteration)
+		{
+			float next[3]{};
+
+			for (int row{}; row < 3; ++row)
+				next[row] = covariance[row][0] * axis[0] + covariance[row][1] * axis[1] + covariance[row][2] * axis[2];
+
+			const float length{ std::sqrt(next[0] * next[0] + next[1] * next[1] + next[2] * next[2]) };
+
+			if (length < FLT_EPSILON)
+				break;
+
+			for (int channel{}; channel < 3; ++channel)
+				axis[channel] = next[channel] / length;
+		}
+
+		float minProjection{ FLT_MAX };
+		float maxProjection{ -FLT_MAX };
+
+		for (int i{}; i < 16; ++i)
+		{
+			float projection{};
+
+			for (int channel{}; channel < 3; ++channel)
+				projection += (GetChannel(texels[i], channel) - mean[channel]) * axis[channel];
+
+			minProjection = std::min(minProjection, projection);
+			maxProjection = std::max(maxProjection, projection);
+		}
+
+		uint16_t color0{ To565(mean[0] + axis[0] * maxProjection, mean[1] + axis[1] * maxProjection, mean[2] + axis[2] * maxProjection) };
+		uint16_t color1{ To565(mean[0] + axis[0] * minProjection, mean[1] + axis[1] * minProjection, mean[2] + axis[2] * minProjection) };
+
+		if (color0 < color1)
+			std::swap(color0, color1);
+
+		uint32_t indices{};
+
+		//Equal endpoints would switch to the three color mode, every index 0 is the same color there
+		if (color0 != color1)
+		{
+			uint32_t palette[4]{};
+			BuildColorPalette(color0, color1, false, palette);
+
+			for (int i{}; i < 16; ++i)
+			{
+				int bestDistance{ INT_MAX };
+				uint32_t bestIndex{};
+
+				for (uint32_t paletteIndex{}; paletteIndex < 4; ++paletteIndex)
+				{
+					int distance{};
+
+					for (int channel{}; channel < 3; ++channel)
+					{
+						const int difference{ GetChannel(texels[i], channel) - GetChannel(palette[paletteIndex], channel) };
+						distance += difference * difference;
+					}
+
+					if (distance < bestDistance)
+					{
+						bestDistance = distance;
+						bestIndex = paletteIndex;
+					}
+				}
+
+				indices |= bestIndex << (i * 2);
+			}
+		}
+
+		pBlock[0] = static_cast<uint8_t>(color0);
+		pBlock[1] = static_cast<uint8_t>(color0 >> 8);
+		pBlock[2] = static_cast<uint8_t>(color1);
+		pBlock[3] = static_cast<uint8_t>(color1 >> 8);
+
+		for (int byte{}; byte < 4; ++byte)
+			pBlock[4 + byte] = static_cast<uint8_t>(indices >> (byte * 8));
+	}
+
+	void DecodeColorBlock(const uint8_t* pBlock, bool allowTransparentIndex, uint32_t texels[16])
+	{
+		const uint16_t color0{ static_cast<uint16_t>(pBlock[0] | (pBlock[1] << 8)) };
+		const uint16_t color1{ static_cast<uint16_t>(pBlock[2] | (pBlock[3] << 8)) };
+
+		uint32_t palette[4]{};
+		BuildColorPalette(color0, color1, allowTransparentIndex && color0 <= color1, palette);
+
+		const uint32_t indices{ static_cast<uint32_t>(pBlock[4] | (pBlock[5] << 8) | (pBlock[6] << 16)) | (static_cast<uint32_t>(pBlock[7]) << 24) };
+
+		for (int i{}; i < 16; ++i)
+			texels[i] = palette[(indices >> (i * 2)) & 3u];
+	}
+
+	//One channel in 8 bytes, the 8 value mode between the extremes of the block
+	void EncodeChannelBlock(const uint32_t texels[16], int channel, uint8_t* pBlock)
+	{
+		uint8_t minValue{ 255 };
+		uint8_t maxValue{ 0 };
+
+		for (int i{}; i < 16; ++i)
+		{
+			minValue = std::min(minValue, GetChannel(texels[i], channel));
+			maxValue = std::max(maxValue, GetChannel(texels[i], channel));
+		}
+
+		uint64_t indices{};
+
+		if (maxValue != minValue)
+		{
+			uint32_t palette[8]{};
+			BuildChannelPalette(maxValue, minValue, palette);
+
+			for (int i{}; i < 16; ++i)
+			{
+				int bestDistance{ INT_MAX };
+				uint64_t bestIndex{};
+
+				for (uint32_t paletteIndex{}; paletteIndex < 8; ++paletteIndex)
+				{
+					const int distance{ std::abs(GetChannel(texels[i], channel) - static_cast<int>(palette[paletteIndex])) };
+
+					if (distance < bestDistance)
+					{
+						bestDistance = distance;
+						bestIndex = paletteIndex;
+					}
+				}
+
+				indices |= bestIndex << (i * 3);
+			}
+		}
+
+		pBlock[0] = maxValue;
+		pBlock[1] = minValue;
+
+		for (int byte{}; byte < 6; ++byte)
+			pBlock[2 + byte] = static_cast<uint8_t>(indices >> (byte * 8));
+	}
+
+	void DecodeChannelBlock(const uint8_t* pBlock, int channel, uint32_t texels[16])
+	{
+		uint32_t palette[8]{};
+		BuildChannelPalette(pBlock[0], pBlock[1], palette);
+
+		uint64_t indices{};
+
+		for (int byte{}; byte < 6; ++byte)
+			indices |= static_cast<uint64_t>(pBlock[2 + byte]) << (byte * 8);
+
+		const uint32_t mask{ ~(255u << (channel * 8)) };
+
+		for (int i{}; i < 16; ++i)
+			texels[i] = (texels[i] & mask) | (palette[(indices >> (i * 3)) & 7u] << (channel * 8));
+	}
+}
+
+
+void dae::BlockCompression::EncodeBC1(const uint32_t texels[16], uint8_t* pBlock)
+{
+	EncodeColorBlock(texels, pBlock);
+}
+
+void dae::BlockCompression::EncodeBC3(const uint32_t texels[16], uint8_t* pBlock)
+{
+	EncodeChannelBlock(texels, 3, pBlock);
+	EncodeColorBlock(texels, pBlock + 8);
+}
+
+void dae::BlockCompression::EncodeBC5(const uint32_t texels[16], uint8_t* pBlock)
+{
+	EncodeChannelBlock(texels, 0, pBlock);
+	EncodeChannelBlock(texels, 1, pBlock + 8);
+}
+
+void dae::BlockCompression::DecodeBC1(const uint8_t* pBlock, uint32_t texels[16])
+{
+	DecodeColorBlock(pBlock, true, texels);
+}
+
+void dae::BlockCompression::DecodeBC3(const uint8_t* pBlock, uint32_t texels[16])
+{
+	DecodeColorBlock(pBlock + 8, false, texels);
+	DecodeChannelBlock(pBlock, 3, texels);
+}
+
+void dae::BlockCompression::DecodeBC5(const uint8_t* pBlock, uint32_t texels[16])
+{
+	for (int i{}; i < 16; ++i)
+		texels[i] = MakeTexel(0, 0, 0, 255);
+
+	DecodeChannelBlock(pBlock, 0, texels);
+	DecodeChannelBlock(pBlock + 8, 1, texels);
+}
@@ -0,0 +1,26 @@
+#pragma once
+#include <cstdint>
+
+
+namespace dae
+{
+	// BC1, BC3 and BC5 blocks as D3D reads them, texels are R, G, B, A bytes in memory
+	// A block is 4x4 texels in row order, 8 bytes for BC1 and 16 for BC3 and BC5
+	namespace BlockCompression
+	{
+		// Endpoints on the principal axis of the colors, alpha is dropped
+		void EncodeBC1(const uint32_t texels[16], uint8_t* pBlock);
+
+		// BC1 colors with a separate 8 bit interpolated alpha
+		void EncodeBC3(const uint32_t texels[16], uint8_t* pBlock);
+
+		// Red and green as two independent channels, for normal maps, blue and alpha are dropped
+		void EncodeBC5(const uint32_t texels[16], uint8_t* pBlock);
+
+		void DecodeBC1(const uint8_t* pBlock, uint32_t texels[16]);
+		void DecodeBC3(const uint8_t* pBlock, uint32_t texels[16]);
+
+		// Blue comes back 0 and alpha 255
+		void DecodeBC5(const uint8_t* pBlock, uint32_t texels[16]);
+	}
+}
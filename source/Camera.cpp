@@ -54,6 +54,12 @@ namespace dae
 		return m_ProjectionMatrix;
 	}
 
+	Matrix Camera::GetReversedProjectionMatrix() const
+	{
+		// Swapping the planes maps near to 1 and far to 0, which keeps float precision where depth values crowd
+		return Matrix::CreatePerspectiveFovLH(m_Fov, m_AspectRatio, m_FarPlane, m_NearPlane);
+	}
+
 	Vector3 Camera::GetOrigin() const
 	{
 		return m_Origin;
@@ -23,6 +23,7 @@ namespace dae
 		Matrix GetViewMatrix() const;
 		const Matrix& GetInverseViewMatrix() const;
 		Matrix GetProjectionMatrix() const;
+		Matrix GetReversedProjectionMatrix() const;
 
 		Vector3 GetOrigin() const;
 
@@ -15,6 +15,16 @@ namespace dae
 		//Vector3 viewDirection{}; 
 	};
 
+	// 20 bytes instead of the 44 of Vertex, see VertexCompression
+	// Positions are 16 bit fractions of the mesh bounds, the uv is half floats, normal and tangent are octahedral
+	struct CompressedVertex
+	{
+		uint16_t position[4]{}; //The fourth only pads to a 4 component input format
+		uint16_t uv[2]{};
+		int16_t normal[2]{};
+		int16_t tangent[2]{};
+	};
+
 	struct Vertex_Out
 	{
 		Vector4 position{};
@@ -25,6 +35,15 @@ namespace dae
 		Vector3 viewDirection{};
 	};
 
+	//Everything of Vertex_Out except the position, only needed for vertices of triangles that get shaded
+	struct VertexAttributes_Out
+	{
+		Vector2 uv{};
+		Vector3 normal{};
+		Vector3 tangent{};
+		Vector3 viewDirection{};
+	};
+
 
 
 
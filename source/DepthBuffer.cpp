@@ -0,0 +1,364 @@
+#include "pch.h"
+#include "DepthBuffer.h"
+
+
+namespace
+{
+	constexpr uint32_t g_MaxUnorm24{ 0xFFFFFF };
+	constexpr uint32_t g_MaxUnorm16{ 0xFFFF };
+
+	// In NDC depth, a few float steps around 1 where all the depth values end up
+	constexpr float g_VisibleTolerance{ 1e-6f };
+}
+
+
+dae::DepthBuffer::DepthBuffer(const PixelLayout& layout)
+	: m_Layout{ layout }
+{
+	m_TileStates.resize(m_Layout.nrTilesX * m_Layout.nrTilesY);
+
+	AllocatePixels();
+}
+
+dae::DepthBuffer::~DepthBuffer()
+{
+	ReleasePixels();
+}
+
+void dae::DepthBuffer::SetFormat(Format format)
+{
+	if (format == m_Format)
+		return;
+
+	ReleasePixels();
+	m_Format = format;
+	AllocatePixels();
+}
+
+dae::DepthBuffer::Format dae::DepthBuffer::GetFormat() const
+{
+	return m_Format;
+}
+
+void dae::DepthBuffer::SetLayout(const PixelLayout& layout)
+{
+	//Every layout of the same screen has the same buffer size, only the sample count can change it
+	const bool isResized{ layout.GetSampleBufferSize() != m_Layout.GetSampleBufferSize() };
+
+	if (isResized)
+		ReleasePixels();
+
+	m_Layout = layout;
+
+	if (isResized)
+		AllocatePixels();
+
+	for (TileState& tileState : m_TileStates)
+		tileState.mode = TileMode::Cleared;
+}
+
+void dae::DepthBuffer::SetReversedZ(bool isReversed)
+{
+	m_IsReversedZ = isReversed;
+
+	for (TileState& tileState : m_TileStates)
+		tileState.mode = TileMode::Cleared;
+}
+
+bool dae::DepthBuffer::IsReversedZ() const
+{
+	return m_IsReversedZ;
+}
+
+void dae::DepthBuffer::SetCompression(bool isEnabled)
+{
+	m_IsCompressionEnabled = isEnabled;
+}
+
+bool dae::DepthBuffer::IsCompressionEnabled() const
+{
+	return m_IsCompressionEnabled;
+}
+
+void dae::DepthBuffer::ResetTile(int tileIdx)
+{
+	m_TileStates[tileIdx].mode = TileMode::Cleared;
+}
+
+bool dae::DepthBuffer::TryCompressTile(int tileIdx, const Plane& plane)
+{
+	if (!m_IsCompressionEnabled)
+		return false;
+
+	TileState& tileState{ m_TileStates[tileIdx] };
+
+	if (tileState.mode == TileMode::Expanded)
+		return false;
+
+
+	int minX{}, minY{}, maxX{}, maxY{};
+	GetTileBounds(tileIdx, minX, minY, maxX, maxY);
+
+	//Outermost sample positions of the tile
+	const float extent{ PixelLayout::GetSampleExtent(m_Layout.sampleCount) };
+	const float left{ minX - extent };
+	const float top{ minY - extent };
+	const float right{ maxX - 1 + extent };
+	const float bottom{ maxY - 1 + extent };
+
+	const float corners[4][2]
+	{
+		{ left, top },
+		{ right, top },
+		{ left, bottom },
+		{ right, bottom }
+	};
+
+	//Both are planes, so the difference is extreme at the corners
+	for (const auto& corner : corners)
+	{
+		const float depth{ plane.Evaluate(corner[0], corner[1]) };
+
+		if (depth < 0.f || depth > 1.f)
+			return false;
+
+		if (tileState.mode == TileMode::Plane && !IsCloser(depth, tileState.plane.Evaluate(corner[0], corner[1])))
+			return false;
+	}
+
+	tileState.mode = TileMode::Plane;
+	tileState.plane = plane;
+	return true;
+}
+
+void dae::DepthBuffer::DecompressTile(int tileIdx)
+{
+	TileState& tileState{ m_TileStates[tileIdx] };
+
+	if (tileState.mode == TileMode::Expanded)
+		return;
+
+
+	int minX{}, minY{}, maxX{}, maxY{};
+	GetTileBounds(tileIdx, minX, minY, maxX, maxY);
+
+	const int sampleCount{ m_Layout.sampleCount };
+
+	if (tileState.mode == TileMode::Cleared)
+	{
+		if (m_Layout.IsTileContiguous())
+			FillCleared(m_Layout.GetTileStart(tileIdx) * sampleCount, (1 << (2 * m_Layout.tileShift)) * sampleCount);
+		else
+		{
+			for (int py{ minY }; py < maxY; ++py)
+				FillCleared((minX + py * m_Layout.width) * sampleCount, (maxX - minX) * sampleCount);
+		}
+	}
+	else
+	{
+		for (int py{ minY }; py < maxY; ++py)
+		{
+			for (int px{ minX }; px < maxX; ++px)
+			{
+				const int pixelIdx{ m_Layout.ToIndex(px, py) };
+
+				for (int sample{}; sample < sampleCount; ++sample)
+				{
+					const Vector2 samplePos{ Vector2{ static_cast<float>(px), static_cast<float>(py) } + PixelLayout::GetSampleOffset(sampleCount, sample) };
+					Store(m_Layout.ToSampleIndex(pixelIdx, sample), tileState.plane.Evaluate(samplePos.x, samplePos.y));
+				}
+			}
+		}
+	}
+
+	tileState.mode = TileMode::Expanded;
+}
+
+bool dae::DepthBuffer::TestAndWrite(int sampleIdx, float depth, bool write)
+{
+	switch (m_Format)
+	{
+	case Format::Float32:
+	{
+		float& storedDepth{ m_pFloatPixels[sampleIdx] };
+
+		if (!IsCloser(depth, storedDepth))
+			return false;
+
+		if (write)
+			storedDepth = depth;
+
+		return true;
+	}
+	case Format::Unorm24:
+	{
+		uint8_t* pStored{ m_pUnorm24Pixels + sampleIdx * 3 };
+		const uint32_t storedDepth{ static_cast<uint32_t>(pStored[0] | (pStored[1] << 8u) | (pStored[2] << 16u)) };
+		const uint32_t encodedDepth{ Encode(depth, g_MaxUnorm24) };
+
+		if (m_IsReversedZ ? encodedDepth <= storedDepth : encodedDepth >= storedDepth)
+			return false;
+
+		if (write)
+		{
+			pStored[0] = static_cast<uint8_t>(encodedDepth);
+			pStored[1] = static_cast<uint8_t>(encodedDepth >> 8u);
+			pStored[2] = static_cast<uint8_t>(encodedDepth >> 16u);
+		}
+
+		return true;
+	}
+	case Format::Unorm16:
+	{
+		uint16_t& storedDepth{ m_pUnorm16Pixels[sampleIdx] };
+		const uint32_t encodedDepth{ Encode(depth, g_MaxUnorm16) };
+
+		if (m_IsReversedZ ? encodedDepth <= storedDepth : encodedDepth >= storedDepth)
+			return false;
+
+		if (write)
+			storedDepth = static_cast<uint16_t>(encodedDepth);
+
+		return true;
+	}
+	}
+
+	return false;
+}
+
+bool dae::DepthBuffer::TestVisible(int sampleIdx, float depth) const
+{
+	switch (m_Format)
+	{
+	case Format::Float32:
+	{
+		const float storedDepth{ m_pFloatPixels[sampleIdx] };
+		return m_IsReversedZ ? depth >= storedDepth - g_VisibleTolerance : depth <= storedDepth + g_VisibleTolerance;
+	}
+	case Format::Unorm24:
+	{
+		const uint8_t* pStored{ m_pUnorm24Pixels + sampleIdx * 3 };
+		const uint32_t storedDepth{ static_cast<uint32_t>(pStored[0] | (pStored[1] << 8u) | (pStored[2] << 16u)) };
+		const uint32_t encodedDepth{ Encode(depth, g_MaxUnorm24) };
+
+		return m_IsReversedZ ? encodedDepth + 1 >= storedDepth : encodedDepth <= storedDepth + 1;
+	}
+	case Format::Unorm16:
+	{
+		const uint32_t storedDepth{ m_pUnorm16Pixels[sampleIdx] };
+		const uint32_t encodedDepth{ Encode(depth, g_MaxUnorm16) };
+
+		return m_IsReversedZ ? encodedDepth + 1 >= storedDepth : encodedDepth <= storedDepth + 1;
+	}
+	}
+
+	return false;
+}
+
+float dae::DepthBuffer::Load(int sampleIdx) const
+{
+	switch (m_Format)
+	{
+	case Format::Float32:
+		return Saturate(m_pFloatPixels[sampleIdx]);
+	case Format::Unorm24:
+	{
+		const uint8_t* pStored{ m_pUnorm24Pixels + sampleIdx * 3 };
+		return static_cast<float>(pStored[0] | (pStored[1] << 8u) | (pStored[2] << 16u)) / g_MaxUnorm24;
+	}
+	case Format::Unorm16:
+		return static_cast<float>(m_pUnorm16Pixels[sampleIdx]) / g_MaxUnorm16;
+	}
+
+	return 1.f;
+}
+
+void dae::DepthBuffer::AllocatePixels()
+{
+	const int nrPixels{ m_Layout.GetSampleBufferSize() };
+
+	switch (m_Format)
+	{
+	case Format::Float32:
+		m_pFloatPixels = new float[nrPixels];
+		break;
+	case Format::Unorm24:
+		m_pUnorm24Pixels = new uint8_t[nrPixels * 3];
+		break;
+	case Format::Unorm16:
+		m_pUnorm16Pixels = new uint16_t[nrPixels];
+		break;
+	}
+
+	for (TileState& tileState : m_TileStates)
+		tileState.mode = TileMode::Cleared;
+}
+
+void dae::DepthBuffer::ReleasePixels()
+{
+	delete[] m_pFloatPixels;
+	delete[] m_pUnorm24Pixels;
+	delete[] m_pUnorm16Pixels;
+
+	m_pFloatPixels = nullptr;
+	m_pUnorm24Pixels = nullptr;
+	m_pUnorm16Pixels = nullptr;
+}
+
+void dae::DepthBuffer::GetTileBounds(int tileIdx, int& minX, int& minY, int& maxX, int& maxY) const
+{
+	const int tileSize{ m_Layout.tileMask + 1 };
+
+	minX = (tileIdx % m_Layout.nrTilesX) * tileSize;
+	minY = (tileIdx / m_Layout.nrTilesX) * tileSize;
+	maxX = std::min(minX + tileSize, m_Layout.width);
+	maxY = std::min(minY + tileSize, m_Layout.height);
+}
+
+void dae::DepthBuffer::FillCleared(int startIdx, int count)
+{
+	switch (m_Format)
+	{
+	case Format::Float32:
+		std::fill_n(m_pFloatPixels + startIdx, count, m_IsReversedZ ? -FLT_MAX : FLT_MAX);
+		break;
+	case Format::Unorm24:
+		std::fill_n(m_pUnorm24Pixels + startIdx * 3, count * 3, static_cast<uint8_t>(m_IsReversedZ ? 0x00 : 0xFF));
+		break;
+	case Format::Unorm16:
+		std::fill_n(m_pUnorm16Pixels + startIdx, count, static_cast<uint16_t>(m_IsReversedZ ? 0 : g_MaxUnorm16));
+		break;
+	}
+}
+
+bool dae::DepthBuffer::IsCloser(float depth, float storedDepth) const
+{
+	return m_IsReversedZ ? depth > storedDepth : depth < storedDepth;
+}
+
+uint32_t dae::DepthBuffer::Encode(float depth, uint32_t maxValue) const
+{
+	return static_cast<uint32_t>(Saturate(depth) * maxValue + 0.5f);
+}
+
+void dae::DepthBuffer::Store(int pixelIdx, float depth)
+{
+	switch (m_Format)
+	{
+	case Format::Float32:
+		m_pFloatPixels[pixelIdx] = depth;
+		break;
+	case Format::Unorm24:
+	{
+		const uint32_t encodedDepth{ Encode(depth, g_MaxUnorm24) };
+		uint8_t* pStored{ m_pUnorm24Pixels + pixelIdx * 3 };
+		pStored[0] = static_cast<uint8_t>(encodedDepth);
+		pStored[1] = static_cast<uint8_t>(encodedDepth >> 8u);
+		pStored[2] = static_cast<uint8_t>(encodedDepth >> 16u);
+		break;
+	}
+	case Format::Unorm16:
+		m_pUnorm16Pixels[pixelIdx] = static_cast<uint16_t>(Encode(depth, g_MaxUnorm16));
+		break;
+	}
+}
@@ -0,0 +1,113 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "PixelLayout.h"
+
+
+namespace dae
+{
+	// Software depth buffer with selectable storage and per tile plane compression
+	// Depth values are NDC z in [0, 1], with reversed-Z the caller passes 1 for the near plane
+	class DepthBuffer final
+	{
+	public:
+
+		enum class Format
+		{
+			Float32,
+			Unorm24,
+			Unorm16,
+
+			COUNT
+		};
+
+		// Depth over a tile as a function of the pixel coordinate: a * x + b * y + c
+		struct Plane
+		{
+			float a{};
+			float b{};
+			float c{};
+
+			float Evaluate(float x, float y) const { return a * x + b * y + c; }
+		};
+
+		DepthBuffer(const PixelLayout& layout);
+		~DepthBuffer();
+
+		DepthBuffer(const DepthBuffer&) = delete;
+		DepthBuffer(DepthBuffer&&) noexcept = delete;
+		DepthBuffer& operator=(const DepthBuffer&) = delete;
+		DepthBuffer& operator=(DepthBuffer&&) noexcept = delete;
+
+		void SetFormat(Format format);
+		Format GetFormat() const;
+
+		// Pixel indices passed in must follow this layout, with one depth per sample
+		void SetLayout(const PixelLayout& layout);
+
+		void SetReversedZ(bool isReversed);
+		bool IsReversedZ() const;
+
+		void SetCompression(bool isEnabled);
+		bool IsCompressionEnabled() const;
+
+		// Marks the tile as cleared without touching its pixels
+		void ResetTile(int tileIdx);
+
+		// Succeeds when the plane of a triangle that covers the whole tile is in front of everything in it
+		// The plane then replaces the tile contents and every pixel of the triangle passes the depth test
+		bool TryCompressTile(int tileIdx, const Plane& plane);
+
+		// Writes out a cleared or compressed tile so it can be tested per pixel
+		void DecompressTile(int tileIdx);
+
+		// Per sample test, the tile must be decompressed
+		bool TestAndWrite(int sampleIdx, float depth, bool write);
+
+		// Passes for the surface that produced the stored depth, used after a depth prepass
+		// A small tolerance absorbs differences between plane and per sample evaluation
+		bool TestVisible(int sampleIdx, float depth) const;
+
+		// Stored depth in [0, 1], the tile must be decompressed
+		float Load(int sampleIdx) const;
+
+	private:
+
+		enum class TileMode
+		{
+			Cleared,
+			Plane,
+			Expanded
+		};
+
+		struct TileState
+		{
+			TileMode mode{ TileMode::Cleared };
+			Plane plane{};
+		};
+
+		PixelLayout m_Layout{};
+
+		Format m_Format{ Format::Float32 };
+		bool m_IsReversedZ{ false };
+		bool m_IsCompressionEnabled{ true };
+
+		// Only the buffer matching m_Format is allocated
+		float* m_pFloatPixels{ nullptr };
+		uint8_t* m_pUnorm24Pixels{ nullptr };
+		uint16_t* m_pUnorm16Pixels{ nullptr };
+
+		std::vector<TileState> m_TileStates{};
+
+		void AllocatePixels();
+		void ReleasePixels();
+
+		void GetTileBounds(int tileIdx, int& minX, int& minY, int& maxX, int& maxY) const;
+		void FillCleared(int startIdx, int count);
+
+		bool IsCloser(float depth, float storedDepth) const;
+		uint32_t Encode(float depth, uint32_t maxValue) const;
+		void Store(int pixelIdx, float depth);
+	};
+}
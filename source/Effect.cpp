@@ -10,47 +10,72 @@ dae::Effect::Effect(ID3D11Device* pDevice, const std::wstring& assetFile)
 	if (!m_pTechnique->IsValid())
 		std::wcout << L"Technique not valid\n";
 
-	m_pMatWorldViewProjVar = m_pEffect->GetVariableByName("gWorldViewProj")->AsMatrix();
-	if (!m_pMatWorldViewProjVar->IsValid())
+	m_pMatViewProjVar = m_pEffect->GetVariableByName("gViewProj")->AsMatrix();
+	if (!m_pMatViewProjVar->IsValid())
 	{
 		std::wcout << L"m_pMatViewProjVar is not valid!\n";
 	}
 
-	m_pMatWorldVar = m_pEffect->GetVariableByName("gWorldMatrix")->AsMatrix();
-	if (!m_pMatWorldVar->IsValid())
-	{
-		std::wcout << L"m_pMatWorldVar is not valid!\n";
-	}
-
 	m_pMatViewInverseVar = m_pEffect->GetVariableByName("gInverseViewMatrix")->AsMatrix();
 	if (!m_pMatViewInverseVar->IsValid())
 	{
 		std::wcout << L"m_pMatViewInverseVar is not valid!\n";
 	}
 
+	m_pIsVertexCompressedVar = m_pEffect->GetVariableByName("gIsVertexCompressed")->AsScalar();
+	if (!m_pIsVertexCompressedVar->IsValid())
+	{
+		std::wcout << L"m_pIsVertexCompressedVar is not valid!\n";
+	}
+
+	m_pPositionMinVar = m_pEffect->GetVariableByName("gPositionMin")->AsVector();
+	if (!m_pPositionMinVar->IsValid())
+	{
+		std::wcout << L"m_pPositionMinVar is not valid!\n";
+	}
+
+	m_pPositionExtentVar = m_pEffect->GetVariableByName("gPositionExtent")->AsVector();
+	if (!m_pPositionExtentVar->IsValid())
+	{
+		std::wcout << L"m_pPositionExtentVar is not valid!\n";
+	}
+
 
 }
 
 dae::Effect::~Effect()
 {
 
-	if (m_pMatWorldViewProjVar)
+	if (m_pMatViewProjVar)
 	{
-		m_pMatWorldViewProjVar->Release();
-		m_pMatWorldViewProjVar = nullptr;
+		m_pMatViewProjVar->Release();
+		m_pMatViewProjVar = nullptr;
 	}
 
-	if (m_pMatWorldVar)
-	{
-		m_pMatWorldVar->Release();
-		m_pMatWorldVar = nullptr;
-	}
 	if (m_pMatViewInverseVar)
 	{
 		m_pMatViewInverseVar->Release();
 		m_pMatViewInverseVar = nullptr;
 	}
 
+	if (m_pIsVertexCompressedVar)
+	{
+		m_pIsVertexCompressedVar->Release();
+		m_pIsVertexCompressedVar = nullptr;
+	}
+
+	if (m_pPositionMinVar)
+	{
+		m_pPositionMinVar->Release();
+		m_pPositionMinVar = nullptr;
+	}
+
+	if (m_pPositionExtentVar)
+	{
+		m_pPositionExtentVar->Release();
+		m_pPositionExtentVar = nullptr;
+	}
+
 
 	if (m_pTechnique)
 	{
@@ -126,22 +151,59 @@ ID3DX11EffectTechnique* dae::Effect::GetTechnique() const
 	return m_pTechnique;
 }
 
-ID3D11InputLayout* dae::Effect::CreateInputLayout(ID3D11Device* pDevice) const
+ID3D11InputLayout* dae::Effect::CreateInputLayout(ID3D11Device* pDevice, bool isVertexCompressed) const
 {
 	//Create Vertex Layout
-	static constexpr uint32_t numElements{ 2 };
+	static constexpr uint32_t numElements{ 8 };
 	D3D11_INPUT_ELEMENT_DESC vertexDesc[numElements]{};
 	vertexDesc[0].SemanticName = "POSITION";
 	vertexDesc[0].Format = DXGI_FORMAT_R32G32B32_FLOAT;
 	vertexDesc[0].AlignedByteOffset = 0;
 	vertexDesc[0].InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA;
 
-	vertexDesc[1].SemanticName = "COLOR";
+	vertexDesc[3].SemanticName = "TEXCOORD";
+	vertexDesc[3].Format = DXGI_FORMAT_R32G32_FLOAT;
+	vertexDesc[3].AlignedByteOffset = 12;
+	vertexDesc[3].InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA;
+
+	vertexDesc[1].SemanticName = "NORMAL";
 	vertexDesc[1].Format = DXGI_FORMAT_R32G32B32_FLOAT;
-	vertexDesc[1].AlignedByteOffset = 12;
+	vertexDesc[1].AlignedByteOffset = 20;
 	vertexDesc[1].InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA;
 
+	vertexDesc[2].SemanticName = "TANGENT";
+	vertexDesc[2].Format = DXGI_FORMAT_R32G32B32_FLOAT;
+	vertexDesc[2].AlignedByteOffset = 32;
+	vertexDesc[2].InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA;
+
+	//CompressedVertex, the shader gets positions in [0, 1] of the bounds and octahedral normals in [-1, 1]
+	if (isVertexCompressed)
+	{
+		vertexDesc[0].Format = DXGI_FORMAT_R16G16B16A16_UNORM;
+		vertexDesc[0].AlignedByteOffset = 0;
+
+		vertexDesc[3].Format = DXGI_FORMAT_R16G16_FLOAT;
+		vertexDesc[3].AlignedByteOffset = 8;
+
+		vertexDesc[1].Format = DXGI_FORMAT_R16G16_SNORM;
+		vertexDesc[1].AlignedByteOffset = 12;
 
+		vertexDesc[2].Format = DXGI_FORMAT_R16G16_SNORM;
+		vertexDesc[2].AlignedByteOffset = 16;
+	}
+
+	//Per instance world matrix rows from the second vertex buffer
+	for (uint32_t row{}; row < 4; ++row)
+	{
+		D3D11_INPUT_ELEMENT_DESC& instanceDesc{ vertexDesc[4 + row] };
+		instanceDesc.SemanticName = "WORLD";
+		instanceDesc.SemanticIndex = row;
+		instanceDesc.Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
+		instanceDesc.InputSlot = 1;
+		instanceDesc.AlignedByteOffset = row * sizeof(Vector4);
+		instanceDesc.InputSlotClass = D3D11_INPUT_PER_INSTANCE_DATA;
+		instanceDesc.InstanceDataStepRate = 1;
+	}
 
 	//Create Input Layout
 	D3DX11_PASS_DESC passDesc{};
@@ -168,15 +230,20 @@ ID3D11InputLayout* dae::Effect::CreateInputLayout(ID3D11Device* pDevice) const
 
 void dae::Effect::SetViewProjectionMatrix(const Matrix& matrix)
 {
-	m_pMatWorldViewProjVar->SetMatrix(reinterpret_cast<const float*>(&matrix));
+	m_pMatViewProjVar->SetMatrix(reinterpret_cast<const float*>(&matrix));
 }
 
-void dae::Effect::SetWorldMatrix(const Matrix& matrix)
+void dae::Effect::SetViewInverseMatrix(const Matrix& matrix)
 {
-	m_pMatWorldVar->SetMatrix(reinterpret_cast<const float*>(&matrix));
+	m_pMatViewInverseVar->SetMatrix(reinterpret_cast<const float*>(&matrix));
 }
 
-void dae::Effect::SetViewInverseMatrix(const Matrix& matrix)
+void dae::Effect::SetVertexFormat(bool isVertexCompressed, const Vector3& positionMin, const Vector3& positionExtent)
 {
-	m_pMatViewInverseVar->SetMatrix(reinterpret_cast<const float*>(&matrix));
+	const float min[4]{ positionMin.x, positionMin.y, positionMin.z, 0.f };
+	const float extent[4]{ positionExtent.x, positionExtent.y, positionExtent.z, 0.f };
+
+	m_pIsVertexCompressedVar->SetBool(isVertexCompressed);
+	m_pPositionMinVar->SetFloatVector(min);
+	m_pPositionExtentVar->SetFloatVector(extent);
 }
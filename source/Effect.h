@@ -25,12 +25,17 @@ namespace dae
 		ID3DX11Effect* GetEffect() const;
 		ID3DX11EffectTechnique* GetTechnique() const;
 
-		virtual ID3D11InputLayout* CreateInputLayout(ID3D11Device* pDevice) const = 0;
+		// Vertex or CompressedVertex (see VertexCompression) plus the per instance world matrix
+		// Effects with other vertex inputs override it
+		virtual ID3D11InputLayout* CreateInputLayout(ID3D11Device* pDevice, bool isVertexCompressed) const;
 
+		// World matrices are per instance vertex data, see Mesh::UpdateInstanceBuffer
 		void SetViewProjectionMatrix(const Matrix& matrix);
-		void SetWorldMatrix(const Matrix& matrix);
 		void SetViewInverseMatrix(const Matrix& matrix);
 
+		// The vertex shader scales positions by positionExtent and offsets them by positionMin, normals are octahedral when compressed
+		void SetVertexFormat(bool isVertexCompressed, const Vector3& positionMin, const Vector3& positionExtent);
+
 		virtual void SetDiffuseMap(const Texture* pDiffuseTexture) = 0;
 		virtual void SetNormalMap(const Texture* pNormalTexture) = 0;
 		virtual void SetSpecularMap(const Texture* pSpecularTexture) = 0;
@@ -44,9 +49,12 @@ namespace dae
 
 		ID3DX11Effect* m_pEffect{ nullptr };
 		ID3DX11EffectTechnique* m_pTechnique{ nullptr };
-		ID3DX11EffectMatrixVariable* m_pMatWorldViewProjVar{ nullptr };
-		ID3DX11EffectMatrixVariable* m_pMatWorldVar{ nullptr };
+		ID3DX11EffectMatrixVariable* m_pMatViewProjVar{ nullptr };
 		ID3DX11EffectMatrixVariable* m_pMatViewInverseVar{ nullptr };
+
+		ID3DX11EffectScalarVariable* m_pIsVertexCompressedVar{ nullptr };
+		ID3DX11EffectVectorVariable* m_pPositionMinVar{ nullptr };
+		ID3DX11EffectVectorVariable* m_pPositionExtentVar{ nullptr };
 	};
 }
 
@@ -19,8 +19,6 @@ namespace dae
 		void SetSpecularMap(const Texture* pSpecularTexture) override;
 		void SetGlossinessMap(const Texture* pGlossinessTexture) override;
 
-		virtual ID3D11InputLayout* CreateInputLayout(ID3D11Device* pDevice) const;
-
 	private:
 		ID3DX11EffectShaderResourceVariable* m_pDiffuseMapVar{ nullptr };
 		ID3DX11EffectShaderResourceVariable* m_pNormalMapVar{ nullptr };
@@ -21,8 +21,6 @@ namespace dae
 		void SetGlossinessMap(const Texture* pGlossinessTexture) override {};
 
 
-		virtual ID3D11InputLayout* CreateInputLayout(ID3D11Device* pDevice) const;
-
 	private:
 		ID3DX11EffectShaderResourceVariable* m_pDiffuseMapVar{ nullptr };
 	};
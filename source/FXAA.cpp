@@ -0,0 +1,222 @@
+#include "pch.h"
+#include "FXAA.h"
+
+#include <ppl.h>
+#include <emmintrin.h>
+
+
+namespace
+{
+	// Rec. 601 weights, the packed colors are already gamma encoded which is what FXAA expects
+	constexpr float g_RedWeight{ 0.299f / 255.f };
+	constexpr float g_GreenWeight{ 0.587f / 255.f };
+	constexpr float g_BlueWeight{ 0.114f / 255.f };
+
+	// Distances walked along an edge to find its ends, growing to reach long edges in few steps
+	constexpr int g_SearchDistances[]{ 1, 2, 3, 4, 5, 6, 8, 10, 12, 16 };
+}
+
+
+dae::FXAA::FXAA(int width, int height)
+	: m_Width{ width }
+	, m_Height{ height }
+	, m_SourcePixels(width * height)
+	, m_Luma(width * height)
+{
+}
+
+void dae::FXAA::Apply(uint32_t* pPixels, uint32_t redShift, uint32_t greenShift, uint32_t blueShift, int tileSize)
+{
+	concurrency::parallel_for(0, m_Height,
+		[&](int py)
+		{
+			ComputeLuma(pPixels, redShift, greenShift, blueShift, py);
+		});
+
+
+	const int nrTilesX{ (m_Width + tileSize - 1) / tileSize };
+	const int nrTilesY{ (m_Height + tileSize - 1) / tileSize };
+
+	concurrency::parallel_for(0, nrTilesX * nrTilesY,
+		[&](int tileIdx)
+		{
+			const int minX{ (tileIdx % nrTilesX) * tileSize };
+			const int minY{ (tileIdx / nrTilesX) * tileSize };
+			const int maxX{ std::min(minX + tileSize, m_Width) };
+			const int maxY{ std::min(minY + tileSize, m_Height) };
+
+			for (int py{ minY }; py < maxY; ++py)
+			{
+				for (int px{ minX }; px < maxX; ++px)
+					pPixels[px + py * m_Width] = FilterPixel(px, py, redShift, greenShift, blueShift);
+			}
+		});
+}
+
+void dae::FXAA::ComputeLuma(const uint32_t* pPixels, uint32_t redShift, uint32_t greenShift, uint32_t blueShift, int py)
+{
+	const uint32_t* pSrc{ pPixels + py * m_Width };
+	uint32_t* pCopy{ m_SourcePixels.data() + py * m_Width };
+	float* pLuma{ m_Luma.data() + py * m_Width };
+
+	std::copy_n(pSrc, m_Width, pCopy);
+
+
+	const __m128i channelMask{ _mm_set1_epi32(0xFF) };
+	const __m128i redCount{ _mm_cvtsi32_si128(static_cast<int>(redShift)) };
+	const __m128i greenCount{ _mm_cvtsi32_si128(static_cast<int>(greenShift)) };
+	const __m128i blueCount{ _mm_cvtsi32_si128(static_cast<int>(blueShift)) };
+
+	const __m128 redWeight{ _mm_set1_ps(g_RedWeight) };
+	const __m128 greenWeight{ _mm_set1_ps(g_GreenWeight) };
+	const __m128 blueWeight{ _mm_set1_ps(g_BlueWeight) };
+
+	// Four pixels at a time, the tail of the row is done one by one
+	int px{};
+
+	for (; px + 4 <= m_Width; px += 4)
+	{
+		const __m128i packed{ _mm_loadu_si128(reinterpret_cast<const __m128i*>(pSrc + px)) };
+
+		const __m128 red{ _mm_cvtepi32_ps(_mm_and_si128(_mm_srl_epi32(packed, redCount), channelMask)) };
+		const __m128 green{ _mm_cvtepi32_ps(_mm_and_si128(_mm_srl_epi32(packed, greenCount), channelMask)) };
+		const __m128 blue{ _mm_cvtepi32_ps(_mm_and_si128(_mm_srl_epi32(packed, blueCount), channelMask)) };
+
+		const __m128 luma{ _mm_add_ps(_mm_add_ps(_mm_mul_ps(red, redWeight), _mm_mul_ps(green, greenWeight)), _mm_mul_ps(blue, blueWeight)) };
+		_mm_storeu_ps(pLuma + px, luma);
+	}
+
+	for (; px < m_Width; ++px)
+	{
+		const uint32_t packed{ pSrc[px] };
+
+		pLuma[px] = ((packed >> redShift) & 0xFF) * g_RedWeight
+			+ ((packed >> greenShift) & 0xFF) * g_GreenWeight
+			+ ((packed >> blueShift) & 0xFF) * g_BlueWeight;
+	}
+}
+
+uint32_t dae::FXAA::FilterPixel(int px, int py, uint32_t redShift, uint32_t greenShift, uint32_t blueShift) const
+{
+	const uint32_t sourcePixel{ m_SourcePixels[px + py * m_Width] };
+
+	const float lumaCenter{ GetLuma(px, py) };
+	const float lumaUp{ GetLuma(px, py - 1) };
+	const float lumaDown{ GetLuma(px, py + 1) };
+	const float lumaLeft{ GetLuma(px - 1, py) };
+	const float lumaRight{ GetLuma(px + 1, py) };
+
+	const float lumaMin{ std::min(lumaCenter, std::min(std::min(lumaUp, lumaDown), std::min(lumaLeft, lumaRight))) };
+	const float lumaMax{ std::max(lumaCenter, std::max(std::max(lumaUp, lumaDown), std::max(lumaLeft, lumaRight))) };
+	const float lumaRange{ lumaMax - lumaMin };
+
+	//Early exit for the vast majority of pixels that are not on an edge
+	if (lumaRange < std::max(m_EdgeThresholdMin, lumaMax * m_EdgeThreshold))
+		return sourcePixel;
+
+
+	const float lumaUpLeft{ GetLuma(px - 1, py - 1) };
+	const float lumaUpRight{ GetLuma(px + 1, py - 1) };
+	const float lumaDownLeft{ GetLuma(px - 1, py + 1) };
+	const float lumaDownRight{ GetLuma(px + 1, py + 1) };
+
+
+	//Second derivatives across both axes decide which way the edge runs
+	const float edgeHorizontal{ std::abs(-2.f * lumaLeft + lumaUpLeft + lumaDownLeft)
+		+ std::abs(-2.f * lumaCenter + lumaUp + lumaDown) * 2.f
+		+ std::abs(-2.f * lumaRight + lumaUpRight + lumaDownRight) };
+
+	const float edgeVertical{ std::abs(-2.f * lumaUp + lumaUpLeft + lumaUpRight)
+		+ std::abs(-2.f * lumaCenter + lumaLeft + lumaRight) * 2.f
+		+ std::abs(-2.f * lumaDown + lumaDownLeft + lumaDownRight) };
+
+	const bool isHorizontal{ edgeHorizontal >= edgeVertical };
+
+
+	//Pick the side of the pixel the edge lies on
+	const float luma1{ isHorizontal ? lumaUp : lumaLeft };
+	const float luma2{ isHorizontal ? lumaDown : lumaRight };
+	const float gradient1{ luma1 - lumaCenter };
+	const float gradient2{ luma2 - lumaCenter };
+
+	const bool isSide1Steepest{ std::abs(gradient1) >= std::abs(gradient2) };
+	const float gradientScaled{ 0.25f * std::max(std::abs(gradient1), std::abs(gradient2)) };
+
+	const int stepSign{ isSide1Steepest ? -1 : 1 };
+	const float lumaLocalAverage{ 0.5f * ((isSide1Steepest ? luma1 : luma2) + lumaCenter) };
+
+
+	//Luma halfway between this pixel row (or column) and the neighbour across the edge
+	const auto getEdgeLuma = [&](int distance)
+		{
+			if (isHorizontal)
+				return 0.5f * (GetLuma(px + distance, py) + GetLuma(px + distance, py + stepSign)) - lumaLocalAverage;
+
+			return 0.5f * (GetLuma(px, py + distance) + GetLuma(px + stepSign, py + distance)) - lumaLocalAverage;
+		};
+
+	const auto searchEdgeEnd = [&](int direction, float& lumaDelta)
+		{
+			for (const int distance : g_SearchDistances)
+			{
+				lumaDelta = getEdgeLuma(direction * distance);
+
+				if (std::abs(lumaDelta) >= gradientScaled)
+					return distance;
+			}
+
+			return g_SearchDistances[std::size(g_SearchDistances) - 1];
+		};
+
+	float lumaDeltaNegative{}, lumaDeltaPositive{};
+	const int distanceNegative{ searchEdgeEnd(-1, lumaDeltaNegative) };
+	const int distancePositive{ searchEdgeEnd(1, lumaDeltaPositive) };
+
+
+	//Only pixels on the side of the closest edge end that matches the center luma get moved
+	const bool isNegativeCloser{ distanceNegative < distancePositive };
+	const float distanceToEnd{ static_cast<float>(std::min(distanceNegative, distancePositive)) };
+	const float edgeLength{ static_cast<float>(distanceNegative + distancePositive) };
+
+	const bool isLumaCenterSmaller{ lumaCenter < lumaLocalAverage };
+	const float lumaDeltaAtEnd{ isNegativeCloser ? lumaDeltaNegative : lumaDeltaPositive };
+	const bool isCorrectVariation{ (lumaDeltaAtEnd < 0.f) != isLumaCenterSmaller };
+
+	const float edgeOffset{ isCorrectVariation ? 0.5f - distanceToEnd / edgeLength : 0.f };
+
+
+	//Subpixel aliasing, based on how much the center differs from its 3x3 neighbourhood
+	const float lumaAverage{ (2.f * (lumaUp + lumaDown + lumaLeft + lumaRight) + lumaUpLeft + lumaUpRight + lumaDownLeft + lumaDownRight) / 12.f };
+	const float subpixelOffset1{ Saturate(std::abs(lumaAverage - lumaCenter) / lumaRange) };
+	const float subpixelOffset2{ (-2.f * subpixelOffset1 + 3.f) * subpixelOffset1 * subpixelOffset1 };
+	const float subpixelOffset{ subpixelOffset2 * subpixelOffset2 * m_SubpixelQuality };
+
+	const float blend{ std::max(edgeOffset, subpixelOffset) };
+
+	if (blend <= 0.f)
+		return sourcePixel;
+
+
+	//Sampling at a fractional offset across the edge is a blend with the pixel on the other side
+	const int neighbourX{ Clamp(isHorizontal ? px : px + stepSign, 0, m_Width - 1) };
+	const int neighbourY{ Clamp(isHorizontal ? py + stepSign : py, 0, m_Height - 1) };
+	const uint32_t neighbourPixel{ m_SourcePixels[neighbourX + neighbourY * m_Width] };
+
+	const auto blendChannel = [&](uint32_t shift)
+		{
+			const float source{ static_cast<float>((sourcePixel >> shift) & 0xFF) };
+			const float neighbour{ static_cast<float>((neighbourPixel >> shift) & 0xFF) };
+
+			return static_cast<uint32_t>(source + (neighbour - source) * blend + 0.5f) << shift;
+		};
+
+	return blendChannel(redShift) | blendChannel(greenShift) | blendChannel(blueShift);
+}
+
+float dae::FXAA::GetLuma(int px, int py) const
+{
+	px = Clamp(px, 0, m_Width - 1);
+	py = Clamp(py, 0, m_Height - 1);
+
+	return m_Luma[px + py * m_Width];
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+
+namespace dae
+{
+	// Edge aware post process antialiasing along the lines of FXAA 3.11 (quality preset)
+	// Runs on the packed display colors, so it works after tonemapping and costs no extra shading
+	class FXAA final
+	{
+	public:
+		FXAA(int width, int height);
+		~FXAA() = default;
+
+		FXAA(const FXAA&) = delete;
+		FXAA(FXAA&&) noexcept = delete;
+		FXAA& operator=(const FXAA&) = delete;
+		FXAA& operator=(FXAA&&) noexcept = delete;
+
+		// Filters the pixels in place, the shifts describe where each channel sits in a packed pixel
+		void Apply(uint32_t* pPixels, uint32_t redShift, uint32_t greenShift, uint32_t blueShift, int tileSize);
+
+	private:
+
+		// Local contrast below max(m_EdgeThresholdMin, maxLuma * m_EdgeThreshold) is left untouched
+		static constexpr float m_EdgeThreshold{ 0.125f };
+		static constexpr float m_EdgeThresholdMin{ 0.0312f };
+		static constexpr float m_SubpixelQuality{ 0.75f };
+
+		int m_Width{};
+		int m_Height{};
+
+		// Unfiltered copy of the frame, tiles read their neighbours from here while writing the result
+		std::vector<uint32_t> m_SourcePixels{};
+		std::vector<float> m_Luma{};
+
+		void ComputeLuma(const uint32_t* pPixels, uint32_t redShift, uint32_t greenShift, uint32_t blueShift, int py);
+		uint32_t FilterPixel(int px, int py, uint32_t redShift, uint32_t greenShift, uint32_t blueShift) const;
+
+		float GetLuma(int px, int py) const;
+	};
+}
@@ -46,8 +46,31 @@ dae::HardwareRasterizer::~HardwareRasterizer()
 }
 
 
-void dae::HardwareRasterizer::Render(Mesh* pMesh) const
+void dae::HardwareRasterizer::Render(Mesh* pMesh, const MeshInstance* const* ppInstances, size_t nrInstances)
 {
+	//Instances drawing the same LOD share one draw call, so their matrices need to be contiguous
+	const int nrLods{ pMesh->GetLodCount() };
+
+	std::vector<uint32_t> lodInstanceCounts(nrLods, 0);
+	m_InstanceMatrices.clear();
+
+	for (int lodLevel{}; lodLevel < nrLods; ++lodLevel)
+	{
+		for (size_t instanceIdx{}; instanceIdx < nrInstances; ++instanceIdx)
+		{
+			const MeshInstance* pInstance{ ppInstances[instanceIdx] };
+
+			if (pInstance->IsActive() && pInstance->GetLodLevel() == lodLevel)
+			{
+				m_InstanceMatrices.emplace_back(pInstance->GetWorldMatrix());
+				++lodInstanceCounts[lodLevel];
+			}
+		}
+	}
+
+	if (m_InstanceMatrices.empty())
+		return;
+
 
 	//1. Set Primitive Topology
 	m_pDeviceContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
@@ -55,33 +78,49 @@ void dae::HardwareRasterizer::Render(Mesh* pMesh) const
 	//2. Set Input Layout
 	m_pDeviceContext->IASetInputLayout(pMesh->GetInputLayout());
 
-	//3. Set Vertex Buffer
-	constexpr UINT stride = sizeof(Vertex);
-	constexpr UINT offset = 0;
+	//3. Set Vertex Buffer, with the world matrices as per instance data next to it
+	pMesh->UpdateInstanceBuffer(m_pDevice, m_pDeviceContext, m_InstanceMatrices);
+
+	const UINT strides[2]{ pMesh->GetVertexStride(), sizeof(Matrix) };
+	constexpr UINT offsets[2]{ 0, 0 };
 
 
-	auto* pvertexBuffer = pMesh->GetVertexBuffer();
+	ID3D11Buffer* pVertexBuffers[2]{ pMesh->GetVertexBuffer(), pMesh->GetInstanceBuffer() };
 
 
-	m_pDeviceContext->IASetVertexBuffers(0, 1, &pvertexBuffer, &stride, &offset);
+	m_pDeviceContext->IASetVertexBuffers(0, 2, pVertexBuffers, strides, offsets);
 
-	//4. Set IndexBuffer
+	//4. Set IndexBuffer, sorted transparent meshes upload their new order first
+	pMesh->UpdateSortedIndexBuffer(m_pDevice, m_pDeviceContext);
 	m_pDeviceContext->IASetIndexBuffer(pMesh->GetIndexBuffer(), DXGI_FORMAT_R32_UINT, 0);
 
 
 	//5. Draw
+	pMesh->BindMaps();
+	pMesh->BindVertexFormat();
+
 	D3DX11_TECHNIQUE_DESC techDesc{};
 	pMesh->GetEffect()->GetTechnique()->GetDesc(&techDesc);
 
 	for (UINT p{ 0 }; p < techDesc.Passes; ++p)
 	{
 		pMesh->GetEffect()->GetTechnique()->GetPassByIndex(p)->Apply(0, m_pDeviceContext);
-		m_pDeviceContext->DrawIndexed(pMesh->GetNumIndices(), 0, 0);
+
+		UINT startInstance{};
+
+		for (int lodLevel{}; lodLevel < nrLods; ++lodLevel)
+		{
+			if (lodInstanceCounts[lodLevel] == 0)
+				continue;
+
+			m_pDeviceContext->DrawIndexedInstanced(pMesh->GetNumIndices(lodLevel), lodInstanceCounts[lodLevel], pMesh->GetIndexStart(lodLevel), 0, startInstance);
+			startInstance += lodInstanceCounts[lodLevel];
+		}
 	}
 }
 
 
-void dae::HardwareRasterizer::HardwareRender(std::vector<Mesh*> pMeshes, bool isBackgroundUniform) const
+void dae::HardwareRasterizer::HardwareRender(const std::vector<MeshInstance*>& pInstances, bool isBackgroundUniform)
 {
 	if (!m_IsInitialized) return;
 
@@ -101,10 +140,17 @@ void dae::HardwareRasterizer::HardwareRender(std::vector<Mesh*> pMeshes, bool is
 
 	//2. Set Pipeline + Invoke Drawcalls (= render)
 
-	for (Mesh* pMesh : pMeshes)
+	for (size_t firstIdx{}; firstIdx < pInstances.size();)
 	{
-		if(pMesh->IsActive())
-			Render(pMesh);
+		Mesh* pMesh{ pInstances[firstIdx]->GetMesh() };
+
+		size_t endIdx{ firstIdx + 1 };
+
+		while (endIdx < pInstances.size() && pInstances[endIdx]->GetMesh() == pMesh)
+			++endIdx;
+
+		Render(pMesh, pInstances.data() + firstIdx, endIdx - firstIdx);
+		firstIdx = endIdx;
 	}
 
 
@@ -236,6 +282,16 @@ void dae::HardwareRasterizer::NextCullingMode(std::vector<Mesh*> pMeshes, Mesh::
 
 
 
+void dae::HardwareRasterizer::ApplyStates(Mesh* pMesh) const
+{
+	//Without a change the effect's own states are still in use
+	if (m_pSamplerState)
+		pMesh->UpdateSampleState(m_pSamplerState);
+
+	if (m_pCullingMode)
+		pMesh->UpdateCullMode(m_pCullingMode);
+}
+
 ID3D11Device* dae::HardwareRasterizer::GetDevice()
 {
 	return m_pDevice;
@@ -1,6 +1,7 @@
 #pragma once
 #include "Camera.h"
 #include "Mesh.h"
+#include "MeshInstance.h"
 struct SDL_Window;
 struct SDL_Surface;
 
@@ -23,8 +24,12 @@ namespace dae
 		void NextSampleStateFilter(std::vector<Mesh*> pMeshes);
 		void NextCullingMode(std::vector<Mesh*> pMeshes, Mesh::CullMode cullMode);
 
+		// Gives a mesh that joined later the sampler and rasterizer states the others were switched to
+		void ApplyStates(Mesh* pMesh) const;
 
-		void HardwareRender(std::vector<Mesh*> pMeshes, bool isBackgroundUniform) const;
+
+		// Consecutive instances of the same mesh become one instanced draw per LOD
+		void HardwareRender(const std::vector<MeshInstance*>& pInstances, bool isBackgroundUniform);
 
 		ID3D11Device* GetDevice();
 
@@ -53,6 +58,9 @@ namespace dae
 
 		ID3D11RasterizerState* m_pCullingMode{ nullptr };
 
+		// World matrices of the batch being drawn, grouped by LOD
+		std::vector<Matrix> m_InstanceMatrices{};
+
 		enum class SampleStateFilters
 		{
 			POINT,
@@ -64,7 +72,7 @@ namespace dae
 		HRESULT InitializeDirectX();
 		void LoadSampleState(const D3D11_FILTER& filter, ID3D11Device* device, std::vector<Mesh*> pMeshes);
 		void LoadCullMode(D3D11_CULL_MODE cullMode, const std::vector<Mesh*>& pMeshes);
-		void Render(Mesh* pMesh) const;
+		void Render(Mesh* pMesh, const MeshInstance* const* ppInstances, size_t nrInstances);
 		//...
 
 
@@ -285,5 +285,24 @@ namespace dae {
 
 		return *this;
 	}
+
+	bool Matrix::operator==(const Matrix& m) const
+	{
+		for (int r{ 0 }; r < 4; ++r)
+		{
+			for (int c{ 0 }; c < 4; ++c)
+			{
+				if (data[r][c] != m.data[r][c])
+					return false;
+			}
+		}
+
+		return true;
+	}
+
+	bool Matrix::operator!=(const Matrix& m) const
+	{
+		return !(*this == m);
+	}
 #pragma endregion
 }
\ No newline at end of file
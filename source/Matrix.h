@@ -56,6 +56,10 @@ namespace dae {
 		Matrix operator*(const Matrix& m) const;
 		const Matrix& operator*=(const Matrix& m);
 
+		// Exact, for telling whether anything moved since last frame
+		bool operator==(const Matrix& m) const;
+		bool operator!=(const Matrix& m) const;
+
 	private:
 
 		//Row-Major Matrix
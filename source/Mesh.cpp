@@ -3,9 +3,13 @@
 #include "Effect.h"
 #include "Utils.h"
 #include "Texture.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "VertexCompression.h"
 
-dae::Mesh::Mesh(ID3D11Device* pDevice, const std::string& objFilePath, Effect* pEffect)
+dae::Mesh::Mesh(ID3D11Device* pDevice, const std::string& objFilePath, Effect* pEffect, VertexFormat vertexFormat)
 	:m_pEffect{ pEffect }
+	,m_VertexFormat{ vertexFormat }
 {
 
 
@@ -14,19 +18,57 @@ dae::Mesh::Mesh(ID3D11Device* pDevice, const std::string& objFilePath, Effect* p
 		std::cout << "Invalid filepath!\n";
 	}
 
+	//File order is arbitrary, reorder once for the vertex cache, overdraw and vertex fetches
+	//ParseOBJ shares vertices between faces, which is what gives the cache something to reuse
+	if (m_PrimitiveTopology == PrimitiveTopology::TriangleList)
+		MeshOptimizer::Optimize(m_Vertices, m_Indices);
 
-	m_pInputLayout = m_pEffect->CreateInputLayout(pDevice);
+	//Reduced index lists over the same vertices, the renderer picks one per frame from the size on screen
+	//Regroups the vertices per LOD, which takes precedence over the fetch order above
+	if (m_PrimitiveTopology == PrimitiveTopology::TriangleList)
+		MeshSimplifier::BuildLodChain(m_Vertices, m_Indices, m_LodIndices, m_LodVertexCounts);
+
+	if (!m_Vertices.empty())
+	{
+		m_BoundsMin = m_Vertices[0].position;
+		m_BoundsMax = m_Vertices[0].position;
+
+		for (const Vertex& vertex : m_Vertices)
+		{
+			m_BoundsMin = Vector3{ std::min(m_BoundsMin.x, vertex.position.x), std::min(m_BoundsMin.y, vertex.position.y), std::min(m_BoundsMin.z, vertex.position.z) };
+			m_BoundsMax = Vector3{ std::max(m_BoundsMax.x, vertex.position.x), std::max(m_BoundsMax.y, vertex.position.y), std::max(m_BoundsMax.z, vertex.position.z) };
+		}
+	}
+
+
+	if (m_PrimitiveTopology == PrimitiveTopology::TriangleList)
+		Meshlet::Build(m_Vertices, m_Indices, m_Meshlets, m_MeshletVertices);
+
+
+	//Everything above works on full vertices, the compressed ones replace them from here on
+	if (m_VertexFormat == VertexFormat::Compressed)
+	{
+		m_CompressedVertices.reserve(m_Vertices.size());
+
+		for (const Vertex& vertex : m_Vertices)
+			m_CompressedVertices.emplace_back(VertexCompression::Encode(vertex, m_BoundsMin, m_BoundsMax - m_BoundsMin));
+
+		std::vector<Vertex>{}.swap(m_Vertices);
+	}
+
+
+	m_pInputLayout = m_pEffect->CreateInputLayout(pDevice, m_VertexFormat == VertexFormat::Compressed);
 
 	//Create Vertex Buffer
 	D3D11_BUFFER_DESC bd{};
 	bd.Usage = D3D11_USAGE_IMMUTABLE;
-	bd.ByteWidth = sizeof(Vertex) * static_cast<uint32_t>(m_Vertices.size());
+	bd.ByteWidth = GetVertexStride() * GetVertexCount();
 	bd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
 	bd.CPUAccessFlags = 0;
 	bd.MiscFlags = 0;
 
 	D3D11_SUBRESOURCE_DATA initData{};
-	initData.pSysMem = m_Vertices.data();
+	initData.pSysMem = m_VertexFormat == VertexFormat::Compressed ? static_cast<const void*>(m_CompressedVertices.data()) : m_Vertices.data();
 
 	HRESULT result = pDevice->CreateBuffer(&bd, &initData, &m_pVertexBuffer);
 	if (FAILED(result))
@@ -35,14 +77,22 @@ dae::Mesh::Mesh(ID3D11Device* pDevice, const std::string& objFilePath, Effect* p
 		return;
 	}
 
-	//Create Index Buffer
-	m_NumIndices = static_cast<uint32_t>(m_Indices.size());
+	//Create Index Buffer, every LOD after the other so a draw only changes its start index
+	std::vector<uint32_t> allLodIndices{ m_Indices };
+	m_LodIndexStarts.assign(1, 0);
+
+	for (const std::vector<uint32_t>& lodIndices : m_LodIndices)
+	{
+		m_LodIndexStarts.emplace_back(static_cast<uint32_t>(allLodIndices.size()));
+		allLodIndices.insert(allLodIndices.end(), lodIndices.begin(), lodIndices.end());
+	}
+
 	bd.Usage = D3D11_USAGE_IMMUTABLE;
-	bd.ByteWidth = sizeof(uint32_t) * m_NumIndices;
+	bd.ByteWidth = sizeof(uint32_t) * static_cast<uint32_t>(allLodIndices.size());
 	bd.BindFlags = D3D11_BIND_INDEX_BUFFER;
 	bd.CPUAccessFlags = 0;
 	bd.MiscFlags = 0;
-	initData.pSysMem = m_Indices.data();
+	initData.pSysMem = allLodIndices.data();
 
 	result = pDevice->CreateBuffer(&bd, &initData, &m_pIndexBuffer);
 	if (FAILED(result))
@@ -57,17 +107,10 @@ dae::Mesh::~Mesh()
 {
 
 	if (m_pIndexBuffer) m_pIndexBuffer->Release();
+	if (m_pSortedIndexBuffer) m_pSortedIndexBuffer->Release();
+	if (m_pInstanceBuffer) m_pInstanceBuffer->Release();
 	if (m_pVertexBuffer) m_pVertexBuffer->Release();
 	if (m_pInputLayout) m_pInputLayout->Release();
-
-	if (m_pEffect) delete m_pEffect;
-
-
-	if (m_pDiffuseMap) delete m_pDiffuseMap;
-	if (m_pNormalMap) delete m_pNormalMap;
-	if (m_pGlossinessMap) delete m_pGlossinessMap;
-	if (m_pSpecularMap) delete m_pSpecularMap;
-
 }
 
 void dae::Mesh::UpdateSampleState(ID3D11SamplerState* pSampleState)
@@ -97,9 +140,25 @@ void dae::Mesh::UpdateCullMode(ID3D11RasterizerState* pRasterizerState)
 
 void dae::Mesh::SetMatrices(const Matrix& viewProjMatrix, const Matrix& inverseViewMatrix)
 {
-	m_pEffect->SetViewProjectionMatrix(m_WorldMatrix * viewProjMatrix);
+	m_pEffect->SetViewProjectionMatrix(viewProjMatrix);
 	m_pEffect->SetViewInverseMatrix(inverseViewMatrix);
-	m_pEffect->SetWorldMatrix(m_WorldMatrix);
+}
+
+void dae::Mesh::BindMaps()
+{
+	if (m_pDiffuseMap) m_pEffect->SetDiffuseMap(m_pDiffuseMap);
+	if (m_pNormalMap) m_pEffect->SetNormalMap(m_pNormalMap);
+	if (m_pSpecularMap) m_pEffect->SetSpecularMap(m_pSpecularMap);
+	if (m_pGlossinessMap) m_pEffect->SetGlossinessMap(m_pGlossinessMap);
+}
+
+void dae::Mesh::BindVertexFormat()
+{
+	//Full vertices go through the same decode as an identity
+	if (m_VertexFormat == VertexFormat::Compressed)
+		m_pEffect->SetVertexFormat(true, m_BoundsMin, m_BoundsMax - m_BoundsMin);
+	else
+		m_pEffect->SetVertexFormat(false, Vector3{ 0.f, 0.f, 0.f }, Vector3{ 1.f, 1.f, 1.f });
 }
 
 void dae::Mesh::SetDiffuseMap(Texture* pDiffuseTexture)
@@ -158,6 +217,9 @@ ID3D11Buffer* dae::Mesh::GetVertexBuffer()
 
 ID3D11Buffer* dae::Mesh::GetIndexBuffer()
 {
+	if (m_pSortedIndexBuffer && !m_SortedLodIndices.empty())
+		return m_pSortedIndexBuffer;
+
 	return m_pIndexBuffer;
 }
 
@@ -166,14 +228,95 @@ dae::Effect* dae::Mesh::GetEffect()
 	return m_pEffect;
 }
 
-uint32_t dae::Mesh::GetNumIndices()
+uint32_t dae::Mesh::GetNumIndices(int lodLevel)
+{
+	return static_cast<uint32_t>(GetDrawIndices(lodLevel).size());
+}
+
+uint32_t dae::Mesh::GetIndexStart(int lodLevel)
+{
+	//The sorted buffer has the same layout as the regular one
+	return m_LodIndexStarts.empty() ? 0 : m_LodIndexStarts[lodLevel];
+}
+
+void dae::Mesh::UpdateInstanceBuffer(ID3D11Device* pDevice, ID3D11DeviceContext* pDeviceContext, const std::vector<Matrix>& worldMatrices)
+{
+	if (worldMatrices.empty())
+		return;
+
+	//Grows to the largest instance count seen, rewritten every frame like the sorted index buffer
+	if (worldMatrices.size() > m_InstanceCapacity)
+	{
+		if (m_pInstanceBuffer)
+		{
+			m_pInstanceBuffer->Release();
+			m_pInstanceBuffer = nullptr;
+		}
+
+		m_InstanceCapacity = std::max(static_cast<uint32_t>(worldMatrices.size()), m_InstanceCapacity * 2);
+
+		D3D11_BUFFER_DESC bd{};
+		bd.Usage = D3D11_USAGE_DYNAMIC;
+		bd.ByteWidth = sizeof(Matrix) * m_InstanceCapacity;
+		bd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+		bd.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+		bd.MiscFlags = 0;
+
+		HRESULT result = pDevice->CreateBuffer(&bd, nullptr, &m_pInstanceBuffer);
+		if (FAILED(result))
+		{
+			std::wcout << L"Instance Buffer creation failed!\n";
+			m_InstanceCapacity = 0;
+			return;
+		}
+	}
+
+	D3D11_MAPPED_SUBRESOURCE mappedResource{};
+	HRESULT result = pDeviceContext->Map(m_pInstanceBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource);
+	if (FAILED(result))
+	{
+		std::wcout << L"Failed to map the instance buffer\n";
+		return;
+	}
+
+	std::memcpy(mappedResource.pData, worldMatrices.data(), sizeof(Matrix) * worldMatrices.size());
+	pDeviceContext->Unmap(m_pInstanceBuffer, 0);
+}
+
+ID3D11Buffer* dae::Mesh::GetInstanceBuffer()
+{
+	return m_pInstanceBuffer;
+}
+
+dae::Mesh::VertexFormat dae::Mesh::GetVertexFormat() const
+{
+	return m_VertexFormat;
+}
+
+uint32_t dae::Mesh::GetVertexStride() const
 {
-	return m_NumIndices;
+	return m_VertexFormat == VertexFormat::Compressed ? sizeof(CompressedVertex) : sizeof(Vertex);
 }
 
-const std::vector<dae::Vertex>& dae::Mesh::GetVertices() const
+uint32_t dae::Mesh::GetVertexCount() const
 {
-	return m_Vertices;
+	return static_cast<uint32_t>(m_VertexFormat == VertexFormat::Compressed ? m_CompressedVertices.size() : m_Vertices.size());
+}
+
+dae::Vertex dae::Mesh::GetVertex(uint32_t index) const
+{
+	if (m_VertexFormat == VertexFormat::Compressed)
+		return VertexCompression::Decode(m_CompressedVertices[index], m_BoundsMin, m_BoundsMax - m_BoundsMin);
+
+	return m_Vertices[index];
+}
+
+dae::Vector3 dae::Mesh::GetPosition(uint32_t index) const
+{
+	if (m_VertexFormat == VertexFormat::Compressed)
+		return VertexCompression::DecodePosition(m_CompressedVertices[index], m_BoundsMin, m_BoundsMax - m_BoundsMin);
+
+	return m_Vertices[index].position;
 }
 
 const std::vector<uint32_t>& dae::Mesh::GetIndices() const
@@ -181,50 +324,116 @@ const std::vector<uint32_t>& dae::Mesh::GetIndices() const
 	return m_Indices;
 }
 
-const std::vector<dae::Vertex_Out>& dae::Mesh::GetVerticesOut() const
+const std::vector<uint32_t>& dae::Mesh::GetDrawIndices(int lodLevel) const
 {
-	return m_VerticesOut;
+	if (!m_SortedLodIndices.empty())
+		return m_SortedLodIndices[lodLevel];
+
+	return GetLodIndices(lodLevel);
 }
 
-void dae::Mesh::SetVerticesOut(const std::vector<Vertex_Out>& newVerticesOut)
+const std::vector<uint32_t>& dae::Mesh::GetLodIndices(int lodLevel) const
 {
-	m_VerticesOut.clear();
-	m_VerticesOut = newVerticesOut;
+	if (lodLevel == 0)
+		return m_Indices;
+
+	return m_LodIndices[lodLevel - 1];
 }
 
-const dae::Matrix& dae::Mesh::GetWorldMatrix() const
+void dae::Mesh::SortTriangles(const Matrix& worldViewMatrix, int lodLevel)
 {
-	return m_WorldMatrix;
+	//Strips can not be reordered per triangle
+	if (!m_IsTransparent || m_PrimitiveTopology != PrimitiveTopology::TriangleList)
+	{
+		m_SortedLodIndices.clear();
+		return;
+	}
+
+	//Every LOD needs a list, an instance can switch to a LOD before it gets sorted
+	if (m_SortedLodIndices.empty())
+	{
+		for (int lod{}; lod < GetLodCount(); ++lod)
+			m_SortedLodIndices.emplace_back(GetLodIndices(lod));
+	}
+
+	m_TriangleSorter.SortBackToFront(*this, GetLodIndices(lodLevel), worldViewMatrix, m_SortedLodIndices[lodLevel]);
+	m_IsSortedIndexBufferDirty = true;
 }
 
-const dae::Mesh::PrimitiveTopology& dae::Mesh::GetPrimitiveTopology() const
+void dae::Mesh::UpdateSortedIndexBuffer(ID3D11Device* pDevice, ID3D11DeviceContext* pDeviceContext)
 {
-	return m_PrimitiveTopology;
+	if (!m_IsSortedIndexBufferDirty || m_SortedLodIndices.empty() || m_LodIndexStarts.empty())
+		return;
+
+	if (!m_pSortedIndexBuffer)
+	{
+		//Rewritten every frame, so unlike the regular index buffer it lives in CPU writable memory
+		D3D11_BUFFER_DESC bd{};
+		bd.Usage = D3D11_USAGE_DYNAMIC;
+		bd.ByteWidth = sizeof(uint32_t) * (m_LodIndexStarts.back() + static_cast<uint32_t>(m_SortedLodIndices.back().size()));
+		bd.BindFlags = D3D11_BIND_INDEX_BUFFER;
+		bd.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+		bd.MiscFlags = 0;
+
+		HRESULT result = pDevice->CreateBuffer(&bd, nullptr, &m_pSortedIndexBuffer);
+		if (FAILED(result))
+		{
+			std::wcout << L"Sorted Index Buffer creation failed!\n";
+			return;
+		}
+	}
+
+	D3D11_MAPPED_SUBRESOURCE mappedResource{};
+	HRESULT result = pDeviceContext->Map(m_pSortedIndexBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource);
+	if (FAILED(result))
+	{
+		std::wcout << L"Failed to map the sorted index buffer\n";
+		return;
+	}
+
+	for (size_t lod{}; lod < m_SortedLodIndices.size(); ++lod)
+		std::memcpy(static_cast<uint32_t*>(mappedResource.pData) + m_LodIndexStarts[lod], m_SortedLodIndices[lod].data(), sizeof(uint32_t) * m_SortedLodIndices[lod].size());
+	pDeviceContext->Unmap(m_pSortedIndexBuffer, 0);
+
+	m_IsSortedIndexBufferDirty = false;
 }
 
-const dae::Mesh::CullMode& dae::Mesh::GetCullMode() const
+const std::vector<dae::Meshlet>& dae::Mesh::GetMeshlets() const
 {
-	return m_CullMode;
+	return m_Meshlets;
 }
 
-void dae::Mesh::SetCullMode(const CullMode& cullMode)
+const std::vector<uint32_t>& dae::Mesh::GetMeshletVertices() const
 {
-	m_CullMode = cullMode;
+	return m_MeshletVertices;
+}
+
+int dae::Mesh::GetLodCount() const
+{
+	return static_cast<int>(m_LodIndices.size()) + 1;
+}
+
+uint32_t dae::Mesh::GetDrawVertexCount(int lodLevel) const
+{
+	if (m_LodVertexCounts.empty())
+		return GetVertexCount();
+
+	return m_LodVertexCounts[lodLevel];
 }
 
-void dae::Mesh::SetWorldMatrix(const Matrix& worldMatrix)
+const dae::Mesh::PrimitiveTopology& dae::Mesh::GetPrimitiveTopology() const
 {
-	m_WorldMatrix = worldMatrix;
+	return m_PrimitiveTopology;
 }
 
-bool dae::Mesh::IsActive() const
+const dae::Mesh::CullMode& dae::Mesh::GetCullMode() const
 {
-	return m_Enabled;
+	return m_CullMode;
 }
 
-void dae::Mesh::SetActive(bool enabled)
+void dae::Mesh::SetCullMode(const CullMode& cullMode)
 {
-	m_Enabled = enabled;
+	m_CullMode = cullMode;
 }
 
 bool dae::Mesh::IsTransparent() const
@@ -236,3 +445,13 @@ void dae::Mesh::SetTransparent(bool isTransparent)
 {
 	m_IsTransparent = isTransparent;
 }
+
+const dae::Vector3& dae::Mesh::GetBoundsMin() const
+{
+	return m_BoundsMin;
+}
+
+const dae::Vector3& dae::Mesh::GetBoundsMax() const
+{
+	return m_BoundsMax;
+}
@@ -1,5 +1,7 @@
 #pragma once
 #include "DataTypes.h"
+#include "TriangleSorter.h"
+#include "Meshlet.h"
 
 
 namespace dae
@@ -30,8 +32,16 @@ namespace dae
 			COUNT
 		};
 
+		// Compressed vertices take less than half the memory, both rasterizers decode them when transforming
+		enum class VertexFormat
+		{
+			Full,
+			Compressed
+		};
+
 
-		Mesh(ID3D11Device* pDevice, const std::string& objFilePath, Effect* pEffect);
+		// The effect and maps are not owned, AssetCache releases them together with the mesh
+		Mesh(ID3D11Device* pDevice, const std::string& objFilePath, Effect* pEffect, VertexFormat vertexFormat = VertexFormat::Full);
 		~Mesh();
 
 		Mesh(const Mesh&) = delete;
@@ -43,10 +53,17 @@ namespace dae
 		void UpdateCullMode(ID3D11RasterizerState* pRasterizerState);
 
 
+		// Per frame camera matrices, the world matrices come from the instance buffer
 		void SetMatrices(const Matrix& viewProjMatrix, const Matrix& inverseViewMatrix);
 
 
 
+		// Effects can be shared between meshes, so the maps are bound again right before drawing
+		void BindMaps();
+
+		// Position bounds and layout the vertex shader decodes compressed vertices with, also per draw
+		void BindVertexFormat();
+
 		void SetDiffuseMap(Texture* pDiffuseTexture);
 		void SetNormalMap(Texture* pNormalTexture);
 		void SetSpecularMap(Texture* pSpecularTexture);
@@ -62,57 +79,104 @@ namespace dae
 		ID3D11Buffer* GetVertexBuffer();
 		ID3D11Buffer* GetIndexBuffer();
 		Effect* GetEffect();
-		uint32_t GetNumIndices();
+		uint32_t GetNumIndices(int lodLevel);
+		uint32_t GetIndexStart(int lodLevel);
+
+		// Uploads one world matrix per instance, bound as the second vertex buffer for instanced draws
+		void UpdateInstanceBuffer(ID3D11Device* pDevice, ID3D11DeviceContext* pDeviceContext, const std::vector<Matrix>& worldMatrices);
+		ID3D11Buffer* GetInstanceBuffer();
 
 
-		const std::vector<Vertex>& GetVertices() const;
+		VertexFormat GetVertexFormat() const;
+		uint32_t GetVertexStride() const;
+		uint32_t GetVertexCount() const;
+
+		// Decoded when the vertices are compressed
+		Vertex GetVertex(uint32_t index) const;
+		Vector3 GetPosition(uint32_t index) const;
+
 		const std::vector<uint32_t>& GetIndices() const;
-		const std::vector<Vertex_Out>& GetVerticesOut() const;
-		void SetVerticesOut(const std::vector<Vertex_Out>& newVerticesOut);
 
-		const Matrix& GetWorldMatrix() const;
+		// Indices of a LOD in the order they should be drawn
+		// Sorted transparent meshes return the back to front order of that LOD
+		const std::vector<uint32_t>& GetDrawIndices(int lodLevel) const;
+
+		// Depth sorts the triangles of one LOD of a transparent triangle list for this frame's view
+		// The order also holds for every instance at that LOD that only differs by a translation
+		void SortTriangles(const Matrix& worldViewMatrix, int lodLevel);
+
+		// Uploads the sorted indices of every LOD to a dynamic index buffer with the layout of the regular one, GetIndexBuffer returns it afterwards
+		void UpdateSortedIndexBuffer(ID3D11Device* pDevice, ID3D11DeviceContext* pDeviceContext);
+
+		// Clusters of the index list, empty for strips
+		const std::vector<Meshlet>& GetMeshlets() const;
+		const std::vector<uint32_t>& GetMeshletVertices() const;
+
+		// LOD 0 is the full mesh, every next one has about half the triangles
+		int GetLodCount() const;
+
+		// A LOD only references the vertices before this count
+		uint32_t GetDrawVertexCount(int lodLevel) const;
+
+
 		const PrimitiveTopology& GetPrimitiveTopology() const;
 		const CullMode& GetCullMode() const;
 		void SetCullMode(const CullMode& cullMode);
 
-		void SetWorldMatrix(const Matrix& worldMatrix);
-		bool IsActive() const;
-		void SetActive(bool enabled);
-
 		bool IsTransparent() const;
 		void SetTransparent(bool isTransparent);
 
+		// Object space bounding box of the vertices
+		const Vector3& GetBoundsMin() const;
+		const Vector3& GetBoundsMax() const;
+
 
 	private:
 
-		bool m_Enabled{true};
 		bool m_IsTransparent{false};
 
+		Vector3 m_BoundsMin{};
+		Vector3 m_BoundsMax{};
+
 
 		Effect* m_pEffect{ nullptr };
 		ID3D11Buffer* m_pVertexBuffer{ nullptr };
 		ID3D11Buffer* m_pIndexBuffer{ nullptr };
 		ID3D11InputLayout* m_pInputLayout{ nullptr };
 
-		uint32_t m_NumIndices{};
-		Matrix m_RotationMatrix{};
+		ID3D11Buffer* m_pInstanceBuffer{ nullptr };
+		uint32_t m_InstanceCapacity{};
 
 
 
+		// Only one of them is filled, depending on the vertex format
+		VertexFormat m_VertexFormat{ VertexFormat::Full };
 		std::vector<Vertex> m_Vertices{};
+		std::vector<CompressedVertex> m_CompressedVertices{};
 		std::vector<uint32_t> m_Indices{};
 
-		std::vector<Vertex_Out> m_VerticesOut{};
+		std::vector<std::vector<uint32_t>> m_LodIndices{};
+		std::vector<uint32_t> m_LodVertexCounts{};
+		std::vector<uint32_t> m_LodIndexStarts{};
+
+		std::vector<Meshlet> m_Meshlets{};
+		std::vector<uint32_t> m_MeshletVertices{};
+
+		TriangleSorter m_TriangleSorter{};
+		// One list per LOD, LODs that were never sorted hold their regular order
+		std::vector<std::vector<uint32_t>> m_SortedLodIndices{};
+		ID3D11Buffer* m_pSortedIndexBuffer{ nullptr };
+		bool m_IsSortedIndexBufferDirty{ false };
 
 		PrimitiveTopology m_PrimitiveTopology{ PrimitiveTopology::TriangleList };
 		CullMode m_CullMode{ CullMode::None };
 
-		Matrix m_WorldMatrix{};
-
 
 		Texture* m_pDiffuseMap{ nullptr };
 		Texture* m_pNormalMap{ nullptr };
 		Texture* m_pGlossinessMap{ nullptr };
 		Texture* m_pSpecularMap{ nullptr };
+
+		const std::vector<uint32_t>& GetLodIndices(int lodLevel) const;
 	};
 }
@@ -0,0 +1,100 @@
+#include "pch.h"
+#include "MeshInstance.h"
+#include "Mesh.h"
+
+
+dae::MeshInstance::MeshInstance(Mesh* pMesh, const Matrix& worldMatrix)
+	:m_pMesh{ pMesh }
+	,m_WorldMatrix{ worldMatrix }
+{
+}
+
+dae::Mesh* dae::MeshInstance::GetMesh() const
+{
+	return m_pMesh;
+}
+
+const dae::Matrix& dae::MeshInstance::GetWorldMatrix() const
+{
+	return m_WorldMatrix;
+}
+
+void dae::MeshInstance::SetWorldMatrix(const Matrix& worldMatrix)
+{
+	m_WorldMatrix = worldMatrix;
+}
+
+bool dae::MeshInstance::IsActive() const
+{
+	return m_Enabled;
+}
+
+void dae::MeshInstance::SetActive(bool enabled)
+{
+	m_Enabled = enabled;
+}
+
+bool dae::MeshInstance::IsOccluder() const
+{
+	return m_IsOccluder;
+}
+
+void dae::MeshInstance::SetOccluder(bool isOccluder)
+{
+	m_IsOccluder = isOccluder;
+}
+
+int dae::MeshInstance::GetLodLevel() const
+{
+	return m_LodLevel;
+}
+
+void dae::MeshInstance::SetLodLevel(int lodLevel)
+{
+	m_LodLevel = std::clamp(lodLevel, 0, m_pMesh->GetLodCount() - 1);
+}
+
+const std::vector<uint32_t>& dae::MeshInstance::GetDrawIndices() const
+{
+	return m_pMesh->GetDrawIndices(m_LodLevel);
+}
+
+uint32_t dae::MeshInstance::GetDrawVertexCount() const
+{
+	return m_pMesh->GetDrawVertexCount(m_LodLevel);
+}
+
+const std::vector<dae::Vector4>& dae::MeshInstance::GetPositionsOut() const
+{
+	return m_PositionsOut;
+}
+
+std::vector<dae::Vector4>& dae::MeshInstance::GetPositionsOut()
+{
+	return m_PositionsOut;
+}
+
+const std::vector<dae::VertexAttributes_Out>& dae::MeshInstance::GetAttributesOut() const
+{
+	return m_AttributesOut;
+}
+
+std::vector<dae::VertexAttributes_Out>& dae::MeshInstance::GetAttributesOut()
+{
+	return m_AttributesOut;
+}
+
+const std::vector<dae::Vector2>& dae::MeshInstance::GetPositionsScreen() const
+{
+	return m_PositionsScreen;
+}
+
+std::vector<dae::Vector2>& dae::MeshInstance::GetPositionsScreen()
+{
+	return m_PositionsScreen;
+}
+
+dae::MeshInstance::TransformCache& dae::MeshInstance::GetTransformCache()
+{
+	return m_TransformCache;
+}
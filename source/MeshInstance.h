@@ -0,0 +1,89 @@
+#pragma once
+#include "DataTypes.h"
+#include "Mesh.h"
+
+
+namespace dae
+{
+	// One placement of a shared Mesh, the geometry, buffers and materials are not copied
+	// Instances of the same mesh should be kept next to each other, the rasterizers batch consecutive ones
+	class MeshInstance final
+	{
+	public:
+
+		explicit MeshInstance(Mesh* pMesh, const Matrix& worldMatrix = Matrix{});
+		~MeshInstance() = default;
+
+		MeshInstance(const MeshInstance&) = delete;
+		MeshInstance(MeshInstance&&) noexcept = delete;
+		MeshInstance& operator=(const MeshInstance&) = delete;
+		MeshInstance& operator=(MeshInstance&&) noexcept = delete;
+
+		Mesh* GetMesh() const;
+
+		const Matrix& GetWorldMatrix() const;
+		void SetWorldMatrix(const Matrix& worldMatrix);
+
+		bool IsActive() const;
+		void SetActive(bool enabled);
+
+		// Occluders are rasterized into the occlusion culling buffer and can hide other instances
+		bool IsOccluder() const;
+		void SetOccluder(bool isOccluder);
+
+		int GetLodLevel() const;
+		void SetLodLevel(int lodLevel);
+
+		// Forwarded to the mesh for this instance's LOD
+		const std::vector<uint32_t>& GetDrawIndices() const;
+		uint32_t GetDrawVertexCount() const;
+
+		// Software rasterizer output, one per instance since every instance is transformed differently
+		// Positions are read by every stage, the attributes only by shading and are filled for the vertices it uses
+		const std::vector<Vector4>& GetPositionsOut() const;
+		std::vector<Vector4>& GetPositionsOut();
+
+		const std::vector<VertexAttributes_Out>& GetAttributesOut() const;
+		std::vector<VertexAttributes_Out>& GetAttributesOut();
+
+		// Positions in pixels, made from GetPositionsOut for the viewport in the transform cache
+		const std::vector<Vector2>& GetPositionsScreen() const;
+		std::vector<Vector2>& GetPositionsScreen();
+
+		// What the software rasterizer output above was made with, it is only redone when one of these changes
+		struct TransformCache
+		{
+			Matrix worldMatrix{};
+			Matrix viewProjectionMatrix{};
+			int lodLevel{ -1 };
+
+			// The meshlet vertex mask, when one is used, also depends on the cull mode, see SoftwareRasterizer::CullMeshlets
+			bool isMasked{ false };
+			Mesh::CullMode cullMode{};
+
+			bool arePositionsValid{ false };
+			bool areAttributesValid{ false };
+
+			int screenWidth{};
+			int screenHeight{};
+			bool arePositionsScreenValid{ false };
+		};
+
+		TransformCache& GetTransformCache();
+
+	private:
+
+		Mesh* m_pMesh{ nullptr };
+
+		Matrix m_WorldMatrix{};
+		bool m_Enabled{ true };
+		bool m_IsOccluder{ false };
+		int m_LodLevel{};
+
+		std::vector<Vector4> m_PositionsOut{};
+		std::vector<VertexAttributes_Out> m_AttributesOut{};
+		std::vector<Vector2> m_PositionsScreen{};
+
+		TransformCache m_TransformCache{};
+	};
+}
@@ -0,0 +1,260 @@
+#include "pch.h"
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <numeric>
+
+
+void dae::MeshOptimizer::OptimizeVertexCache(std::vector<uint32_t>& indices, size_t nrVertices, std::vector<uint32_t>& clusterStarts, int cacheSize)
+{
+	clusterStarts.clear();
+
+	const size_t nrTriangles{ indices.size() / 3 };
+
+	if (nrTriangles == 0)
+		return;
+
+
+	//Vertex -> triangle adjacency in one flat array
+	std::vector<uint32_t> liveTriangles(nrVertices, 0);
+
+	for (const uint32_t index : indices)
+		++liveTriangles[index];
+
+	std::vector<uint32_t> adjacencyOffsets(nrVertices + 1, 0);
+	std::partial_sum(liveTriangles.begin(), liveTriangles.end(), adjacencyOffsets.begin() + 1);
+
+	std::vector<uint32_t> adjacency(indices.size());
+	std::vector<uint32_t> fillCounts(nrVertices, 0);
+
+	for (size_t triangleIdx{}; triangleIdx < nrTriangles; ++triangleIdx)
+	{
+		for (int corner{}; corner < 3; ++corner)
+		{
+			const uint32_t vertex{ indices[triangleIdx * 3 + corner] };
+			adjacency[adjacencyOffsets[vertex] + fillCounts[vertex]++] = static_cast<uint32_t>(triangleIdx);
+		}
+	}
+
+
+	std::vector<int> cacheTimeStamps(nrVertices, 0);
+	std::vector<uint8_t> isEmitted(nrTriangles, 0);
+	std::vector<uint32_t> deadEndStack{};
+	std::vector<uint32_t> candidates{};
+
+	std::vector<uint32_t> output{};
+	output.reserve(indices.size());
+
+	int time{ cacheSize + 1 };
+	size_t cursor{};
+
+	//Most recently referenced vertex that still has triangles, then any vertex that does
+	const auto skipDeadEnd = [&]() -> int64_t
+		{
+			while (!deadEndStack.empty())
+			{
+				const uint32_t vertex{ deadEndStack.back() };
+				deadEndStack.pop_back();
+
+				if (liveTriangles[vertex] > 0)
+					return vertex;
+			}
+
+			while (cursor < nrVertices)
+			{
+				if (liveTriangles[cursor] > 0)
+					return static_cast<int64_t>(cursor);
+
+				++cursor;
+			}
+
+			return -1;
+		};
+
+	int64_t fanningVertex{ skipDeadEnd() };
+
+	while (fanningVertex >= 0)
+	{
+		candidates.clear();
+
+		//Emit every remaining triangle around the fanning vertex
+		for (uint32_t adjacencyIdx{ adjacencyOffsets[fanningVertex] }; adjacencyIdx < adjacencyOffsets[fanningVertex + 1]; ++adjacencyIdx)
+		{
+			const uint32_t triangleIdx{ adjacency[adjacencyIdx] };
+
+			if (isEmitted[triangleIdx])
+				continue;
+
+			for (int corner{}; corner < 3; ++corner)
+			{
+				const uint32_t vertex{ indices[triangleIdx * 3 + corner] };
+
+				output.emplace_back(vertex);
+				deadEndStack.emplace_back(vertex);
+				candidates.emplace_back(vertex);
+				--liveTriangles[vertex];
+
+				if (time - cacheTimeStamps[vertex] > cacheSize)
+					cacheTimeStamps[vertex] = time++;
+			}
+
+			isEmitted[triangleIdx] = 1;
+		}
+
+
+		//Next fanning vertex: the one that stays in the cache the longest while its fan is emitted
+		int64_t nextVertex{ -1 };
+		int bestPriority{ -1 };
+
+		for (const uint32_t vertex : candidates)
+		{
+			if (liveTriangles[vertex] == 0)
+				continue;
+
+			int priority{};
+
+			if (time - cacheTimeStamps[vertex] + 2 * static_cast<int>(liveTriangles[vertex]) <= cacheSize)
+				priority = time - cacheTimeStamps[vertex];
+
+			if (priority > bestPriority)
+			{
+				bestPriority = priority;
+				nextVertex = vertex;
+			}
+		}
+
+		if (nextVertex < 0)
+		{
+			nextVertex = skipDeadEnd();
+
+			//Jumping elsewhere in the mesh starts a new cluster
+			if (nextVertex >= 0)
+				clusterStarts.emplace_back(static_cast<uint32_t>(output.size() / 3));
+		}
+
+		fanningVertex = nextVertex;
+	}
+
+	clusterStarts.insert(clusterStarts.begin(), 0u);
+	indices.swap(output);
+}
+
+void dae::MeshOptimizer::OptimizeOverdraw(const std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, const std::vector<uint32_t>& clusterStarts)
+{
+	const uint32_t nrTriangles{ static_cast<uint32_t>(indices.size() / 3) };
+	const size_t nrClusters{ clusterStarts.size() };
+
+	if (nrClusters <= 1)
+		return;
+
+
+	const auto getClusterEnd = [&](size_t clusterIdx)
+		{
+			return clusterIdx + 1 < nrClusters ? clusterStarts[clusterIdx + 1] : nrTriangles;
+		};
+
+	//Area weighted centroid of the whole mesh
+	Vector3 meshCentroid{};
+	float meshArea{};
+
+	std::vector<Vector3> clusterCentroids(nrClusters);
+	std::vector<Vector3> clusterNormals(nrClusters);
+
+	for (size_t clusterIdx{}; clusterIdx < nrClusters; ++clusterIdx)
+	{
+		Vector3 centroid{};
+		Vector3 normal{};
+		float area{};
+
+		for (uint32_t triangleIdx{ clusterStarts[clusterIdx] }; triangleIdx < getClusterEnd(clusterIdx); ++triangleIdx)
+		{
+			const Vertex& v0{ vertices[indices[triangleIdx * 3]] };
+			const Vertex& v1{ vertices[indices[triangleIdx * 3 + 1]] };
+			const Vertex& v2{ vertices[indices[triangleIdx * 3 + 2]] };
+
+			Vector3 faceNormal{ Vector3::Cross(v1.position - v0.position, v2.position - v0.position) };
+
+			//Winding is mesh dependent, the authored normals tell which side is outward
+			if (Vector3::Dot(faceNormal, v0.normal + v1.normal + v2.normal) < 0.f)
+				faceNormal = -faceNormal;
+
+			const float triangleArea{ faceNormal.Magnitude() * 0.5f };
+
+			centroid += (v0.position + v1.position + v2.position) * (triangleArea / 3.f);
+			normal += faceNormal;
+			area += triangleArea;
+		}
+
+		meshCentroid += centroid;
+		meshArea += area;
+
+		clusterCentroids[clusterIdx] = area > FLT_EPSILON ? centroid / area : Vector3{};
+		clusterNormals[clusterIdx] = normal.Magnitude() > FLT_EPSILON ? normal.Normalized() : Vector3{};
+	}
+
+	if (meshArea <= FLT_EPSILON)
+		return;
+
+	meshCentroid = meshCentroid / meshArea;
+
+
+	//Occlusion potential: how far out a cluster sits along its own normal
+	std::vector<float> sortKeys(nrClusters);
+
+	for (size_t clusterIdx{}; clusterIdx < nrClusters; ++clusterIdx)
+		sortKeys[clusterIdx] = Vector3::Dot(clusterCentroids[clusterIdx] - meshCentroid, clusterNormals[clusterIdx]);
+
+	std::vector<uint32_t> clusterOrder(nrClusters);
+	std::iota(clusterOrder.begin(), clusterOrder.end(), 0u);
+
+	std::stable_sort(clusterOrder.begin(), clusterOrder.end(),
+		[&](uint32_t a, uint32_t b)
+		{
+			return sortKeys[a] > sortKeys[b];
+		});
+
+
+	std::vector<uint32_t> output{};
+	output.reserve(indices.size());
+
+	for (const uint32_t clusterIdx : clusterOrder)
+	{
+		output.insert(output.end(), indices.begin() + clusterStarts[clusterIdx] * 3, indices.begin() + getClusterEnd(clusterIdx) * 3);
+	}
+
+	indices.swap(output);
+}
+
+void dae::MeshOptimizer::OptimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+{
+	std::vector<uint32_t> remap(vertices.size(), UINT32_MAX);
+
+	std::vector<Vertex> output{};
+	output.reserve(vertices.size());
+
+	for (uint32_t& index : indices)
+	{
+		if (remap[index] == UINT32_MAX)
+		{
+			remap[index] = static_cast<uint32_t>(output.size());
+			output.emplace_back(vertices[index]);
+		}
+
+		index = remap[index];
+	}
+
+	//Vertices no index refers to are dropped
+	vertices.swap(output);
+}
+
+void dae::MeshOptimizer::Optimize(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, bool optimizeOverdraw)
+{
+	std::vector<uint32_t> clusterStarts{};
+
+	OptimizeVertexCache(indices, vertices.size(), clusterStarts);
+
+	if (optimizeOverdraw)
+		OptimizeOverdraw(vertices, indices, clusterStarts);
+
+	OptimizeVertexFetch(vertices, indices);
+}
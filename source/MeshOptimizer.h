@@ -0,0 +1,30 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "DataTypes.h"
+
+
+namespace dae
+{
+	// Load time reordering of indexed triangle lists, the same triangles are drawn in another order
+	// Only lists where triangles share vertices gain anything, a vertex per corner is never reused from the cache
+	// Opaque meshes look the same apart from ties between coplanar triangles, blended results depend on draw order,
+	// so transparent meshes rely on Mesh::SortTriangles putting them back to front every frame
+	namespace MeshOptimizer
+	{
+		// Tipsify (Sander et al. 2007): reorders triangles for post transform vertex cache hits
+		// Writes the start of every cluster the order breaks into, where the cache is effectively flushed
+		void OptimizeVertexCache(std::vector<uint32_t>& indices, size_t nrVertices, std::vector<uint32_t>& clusterStarts, int cacheSize = 16);
+
+		// Reorders the vertex cache clusters so outward facing ones on the outside of the mesh come first
+		// Front most surfaces then tend to be drawn early, which saves shading on hidden ones
+		void OptimizeOverdraw(const std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, const std::vector<uint32_t>& clusterStarts);
+
+		// Renumbers vertices in the order the index list first uses them, so fetches walk memory forward
+		void OptimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+
+		// All of the above in the right order
+		void Optimize(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, bool optimizeOverdraw = true);
+	}
+}
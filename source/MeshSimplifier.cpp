@@ -0,0 +1,376 @@
+#include "pch.h"
+#include "MeshSimplifier.h"
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <limits>
+#include <unordered_map>
+
+
+namespace
+{
+	//Symmetric 4x4 matrix of summed squared plane distances, weighted by triangle area
+	struct Quadric
+	{
+		double a2{}, b2{}, c2{}, d2{};
+		double ab{}, ac{}, ad{}, bc{}, bd{}, cd{};
+		double weight{};
+
+		void AddPlane(double a, double b, double c, double d, double w)
+		{
+			a2 += w * a * a; b2 += w * b * b; c2 += w * c * c; d2 += w * d * d;
+			ab += w * a * b; ac += w * a * c; ad += w * a * d;
+			bc += w * b * c; bd += w * b * d; cd += w * c * d;
+			weight += w;
+		}
+
+		void Add(const Quadric& other)
+		{
+			a2 += other.a2; b2 += other.b2; c2 += other.c2; d2 += other.d2;
+			ab += other.ab; ac += other.ac; ad += other.ad;
+			bc += other.bc; bd += other.bd; cd += other.cd;
+			weight += other.weight;
+		}
+
+		//Area weighted mean of the squared distances to all planes
+		double Evaluate(const dae::Vector3& p) const
+		{
+			if (weight <= 0.0)
+				return 0.0;
+
+			const double x{ p.x }, y{ p.y }, z{ p.z };
+
+			const double error{ a2 * x * x + b2 * y * y + c2 * z * z
+				+ 2.0 * (ab * x * y + ac * x * z + bc * y * z)
+				+ 2.0 * (ad * x + bd * y + cd * z)
+				+ d2 };
+
+			return std::abs(error) / weight;
+		}
+	};
+
+	struct Collapse
+	{
+		uint32_t from{};
+		uint32_t to{};
+		double error{};
+	};
+
+	uint64_t GetEdgeKey(uint32_t a, uint32_t b)
+	{
+		return (static_cast<uint64_t>(std::min(a, b)) << 32) | std::max(a, b);
+	}
+}
+
+
+void dae::MeshSimplifier::Simplify(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, size_t targetIndexCount, float maxError, std::vector<uint32_t>& result)
+{
+	result = indices;
+
+	const size_t nrVertices{ vertices.size() };
+
+	if (result.size() <= targetIndexCount || nrVertices == 0)
+		return;
+
+
+	//Edges used by one triangle are borders, the OBJ parser also splits vertices on uv and normal seams so those count too
+	//Moving such a vertex would tear the surface open, so they stay where they are
+	std::unordered_map<uint64_t, uint32_t> edgeUseCounts{};
+	edgeUseCounts.reserve(result.size());
+
+	for (size_t i{}; i < result.size(); i += 3)
+	{
+		for (int corner{}; corner < 3; ++corner)
+			++edgeUseCounts[GetEdgeKey(result[i + corner], result[i + (corner + 1) % 3])];
+	}
+
+	std::vector<uint8_t> isLocked(nrVertices, 0);
+
+	for (const auto& [key, useCount] : edgeUseCounts)
+	{
+		if (useCount != 2)
+		{
+			isLocked[static_cast<uint32_t>(key >> 32)] = 1;
+			isLocked[static_cast<uint32_t>(key & 0xFFFFFFFF)] = 1;
+		}
+	}
+
+
+	std::vector<Quadric> quadrics(nrVertices);
+
+	for (size_t i{}; i < result.size(); i += 3)
+	{
+		const Vector3& p0{ vertices[result[i]].position };
+		const Vector3& p1{ vertices[result[i + 1]].position };
+		const Vector3& p2{ vertices[result[i + 2]].position };
+
+		const Vector3 normal{ Vector3::Cross(p1 - p0, p2 - p0) };
+		const float doubleArea{ normal.Magnitude() };
+
+		if (doubleArea <= 0.f)
+			continue;
+
+		const Vector3 unitNormal{ normal / doubleArea };
+		const double d{ -Vector3::Dot(unitNormal, p0) };
+
+		for (int corner{}; corner < 3; ++corner)
+			quadrics[result[i + corner]].AddPlane(unitNormal.x, unitNormal.y, unitNormal.z, d, doubleArea * 0.5);
+	}
+
+
+	const double maxErrorSquared{ static_cast<double>(maxError) * maxError };
+
+	std::vector<uint32_t> remap(nrVertices);
+	std::vector<uint8_t> isTouched(nrVertices);
+	std::vector<Collapse> collapses{};
+	std::vector<uint32_t> adjacencyOffsets(nrVertices + 1);
+	std::vector<uint32_t> adjacency{};
+
+
+	//Every pass collapses a batch of independent edges, cheapest first, then rebuilds the connectivity
+	while (result.size() > targetIndexCount)
+	{
+		const size_t nrTriangles{ result.size() / 3 };
+
+		//Vertex -> triangle adjacency of the current index list
+		std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0);
+
+		for (const uint32_t index : result)
+			++adjacencyOffsets[index + 1];
+
+		for (size_t v{}; v < nrVertices; ++v)
+			adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+
+		adjacency.resize(result.size());
+		std::vector<uint32_t> fillCounts(nrVertices, 0);
+
+		for (size_t triangleIdx{}; triangleIdx < nrTriangles; ++triangleIdx)
+		{
+			for (int corner{}; corner < 3; ++corner)
+			{
+				const uint32_t vertex{ result[triangleIdx * 3 + corner] };
+				adjacency[adjacencyOffsets[vertex] + fillCounts[vertex]++] = static_cast<uint32_t>(triangleIdx);
+			}
+		}
+
+
+		//Cheapest allowed direction of every edge, interior edges show up twice which the touched flags filter out
+		collapses.clear();
+
+		for (size_t i{}; i < result.size(); i += 3)
+		{
+			for (int corner{}; corner < 3; ++corner)
+			{
+				const uint32_t a{ result[i + corner] };
+				const uint32_t b{ result[i + (corner + 1) % 3] };
+
+				if (isLocked[a] && isLocked[b])
+					continue;
+
+				Quadric quadric{ quadrics[a] };
+				quadric.Add(quadrics[b]);
+
+				const double errorAToB{ isLocked[a] ? std::numeric_limits<double>::max() : quadric.Evaluate(vertices[b].position) };
+				const double errorBToA{ isLocked[b] ? std::numeric_limits<double>::max() : quadric.Evaluate(vertices[a].position) };
+
+				if (errorAToB <= errorBToA)
+					collapses.emplace_back(Collapse{ a, b, errorAToB });
+				else
+					collapses.emplace_back(Collapse{ b, a, errorBToA });
+			}
+		}
+
+		std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) { return a.error < b.error; });
+
+
+		//A collapse removes about two triangles
+		const size_t trianglesToRemove{ (result.size() - targetIndexCount) / 3 };
+		size_t trianglesRemoved{};
+
+		std::fill(isTouched.begin(), isTouched.end(), 0);
+
+		for (size_t v{}; v < nrVertices; ++v)
+			remap[v] = static_cast<uint32_t>(v);
+
+		for (const Collapse& collapse : collapses)
+		{
+			if (collapse.error > maxErrorSquared || trianglesRemoved >= trianglesToRemove)
+				break;
+
+			if (isTouched[collapse.from] || isTouched[collapse.to])
+				continue;
+
+			const Vector3& toPosition{ vertices[collapse.to].position };
+
+
+			//Reject collapses that would flip a remaining triangle around
+			bool isFlipping{ false };
+			size_t nrCollapsedTriangles{};
+
+			for (uint32_t adjacencyIdx{ adjacencyOffsets[collapse.from] }; adjacencyIdx < adjacencyOffsets[collapse.from + 1]; ++adjacencyIdx)
+			{
+				const size_t triangleStart{ adjacency[adjacencyIdx] * size_t{ 3 } };
+
+				Vector3 before[3]{};
+				Vector3 after[3]{};
+				bool hasTarget{ false };
+
+				for (int corner{}; corner < 3; ++corner)
+				{
+					const uint32_t vertex{ result[triangleStart + corner] };
+
+					hasTarget |= vertex == collapse.to;
+					before[corner] = vertices[vertex].position;
+					after[corner] = vertex == collapse.from ? toPosition : before[corner];
+				}
+
+				if (hasTarget)
+				{
+					++nrCollapsedTriangles;
+					continue;
+				}
+
+				const Vector3 normalBefore{ Vector3::Cross(before[1] - before[0], before[2] - before[0]) };
+				const Vector3 normalAfter{ Vector3::Cross(after[1] - after[0], after[2] - after[0]) };
+
+				if (Vector3::Dot(normalBefore, normalAfter) <= 0.f)
+				{
+					isFlipping = true;
+					break;
+				}
+			}
+
+			if (isFlipping)
+				continue;
+
+
+			remap[collapse.from] = collapse.to;
+			quadrics[collapse.to].Add(quadrics[collapse.from]);
+			trianglesRemoved += nrCollapsedTriangles;
+
+			//The triangles around the moved vertex changed shape, so their other collapses wait for the next pass
+			for (uint32_t adjacencyIdx{ adjacencyOffsets[collapse.from] }; adjacencyIdx < adjacencyOffsets[collapse.from + 1]; ++adjacencyIdx)
+			{
+				const size_t triangleStart{ adjacency[adjacencyIdx] * size_t{ 3 } };
+
+				for (int corner{}; corner < 3; ++corner)
+					isTouched[result[triangleStart + corner]] = 1;
+			}
+		}
+
+		if (trianglesRemoved == 0)
+			break;
+
+
+		//Apply the collapses and drop the triangles that became degenerate
+		size_t writeIdx{};
+
+		for (size_t i{}; i < result.size(); i += 3)
+		{
+			const uint32_t v0{ remap[result[i]] };
+			const uint32_t v1{ remap[result[i + 1]] };
+			const uint32_t v2{ remap[result[i + 2]] };
+
+			if (v0 == v1 || v1 == v2 || v2 == v0)
+				continue;
+
+			result[writeIdx++] = v0;
+			result[writeIdx++] = v1;
+			result[writeIdx++] = v2;
+		}
+
+		result.resize(writeIdx);
+	}
+}
+
+
+void dae::MeshSimplifier::BuildLodChain(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, std::vector<std::vector<uint32_t>>& lods, std::vector<uint32_t>& lodVertexCounts, int maxLods)
+{
+	lods.clear();
+	lodVertexCounts.assign(1, static_cast<uint32_t>(vertices.size()));
+
+	if (indices.empty() || vertices.empty())
+		return;
+
+
+	Vector3 boundsMin{ vertices[0].position };
+	Vector3 boundsMax{ vertices[0].position };
+
+	for (const Vertex& vertex : vertices)
+	{
+		boundsMin = Vector3{ std::min(boundsMin.x, vertex.position.x), std::min(boundsMin.y, vertex.position.y), std::min(boundsMin.z, vertex.position.z) };
+		boundsMax = Vector3{ std::max(boundsMax.x, vertex.position.x), std::max(boundsMax.y, vertex.position.y), std::max(boundsMax.z, vertex.position.z) };
+	}
+
+	const float extent{ (boundsMax - boundsMin).Magnitude() };
+
+
+	//Every LOD starts from the previous one, so its vertices are a subset of the finer LOD's vertices
+	std::vector<uint32_t> clusterStarts{};
+
+	for (int lod{ 1 }; lod <= maxLods; ++lod)
+	{
+		const std::vector<uint32_t>& source{ lods.empty() ? indices : lods.back() };
+		const size_t targetIndexCount{ (indices.size() / 3 >> lod) * 3 };
+
+		//Coarser LODs are seen from further away, so they may deviate further
+		const float maxError{ extent * 0.01f * static_cast<float>(1 << (lod - 1)) };
+
+		std::vector<uint32_t> lodIndices{};
+		Simplify(vertices, source, targetIndexCount, maxError, lodIndices);
+
+		//Not worth a level of its own
+		if (lodIndices.empty() || lodIndices.size() * 10 > source.size() * 9)
+			break;
+
+		MeshOptimizer::OptimizeVertexCache(lodIndices, vertices.size(), clusterStarts);
+		lods.emplace_back(std::move(lodIndices));
+	}
+
+	if (lods.empty())
+		return;
+
+
+	//Coarsest LOD's vertices first, then the ones each finer LOD adds, in first use order
+	//Within its own range every LOD still fetches forward, only the vertices it shares with coarser LODs are out of order
+	constexpr uint32_t unassigned{ UINT32_MAX };
+	std::vector<uint32_t> newIndices(vertices.size(), unassigned);
+	uint32_t nrAssigned{};
+
+	lodVertexCounts.assign(lods.size() + 1, 0);
+
+	for (int lod{ static_cast<int>(lods.size()) }; lod >= 0; --lod)
+	{
+		for (const uint32_t index : (lod == 0 ? indices : lods[lod - 1]))
+		{
+			if (newIndices[index] == unassigned)
+				newIndices[index] = nrAssigned++;
+		}
+
+		lodVertexCounts[lod] = nrAssigned;
+	}
+
+	//Vertices no triangle uses go last
+	for (uint32_t& newIndex : newIndices)
+	{
+		if (newIndex == unassigned)
+			newIndex = nrAssigned++;
+	}
+
+
+	std::vector<Vertex> reorderedVertices(vertices.size());
+
+	for (size_t v{}; v < vertices.size(); ++v)
+		reorderedVertices[newIndices[v]] = vertices[v];
+
+	vertices.swap(reorderedVertices);
+
+	for (uint32_t& index : indices)
+		index = newIndices[index];
+
+	for (std::vector<uint32_t>& lodIndices : lods)
+	{
+		for (uint32_t& index : lodIndices)
+			index = newIndices[index];
+	}
+}
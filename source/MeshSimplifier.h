@@ -0,0 +1,23 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "DataTypes.h"
+
+
+namespace dae
+{
+	// Load time level of detail generation for indexed triangle lists
+	namespace MeshSimplifier
+	{
+		// Quadric error metric edge collapse (Garland & Heckbert 1997) onto existing vertices, so every LOD shares the vertex array
+		// Border and attribute seam vertices never move, maxError is an object space distance
+		void Simplify(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, size_t targetIndexCount, float maxError, std::vector<uint32_t>& result);
+
+		// Each LOD halves the triangles of the previous one, stops early once a mesh no longer simplifies
+		// Vertices are reordered so every LOD only uses a prefix of the array, lodVertexCounts holds that prefix per LOD (0 is the full mesh)
+		// This replaces the fetch order MeshOptimizer gave the full mesh, each LOD's own vertices are kept in its first use order,
+		// but the full mesh jumps back into the shared coarser ranges, a trade for the smaller vertex ranges of the LODs
+		void BuildLodChain(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, std::vector<std::vector<uint32_t>>& lods, std::vector<uint32_t>& lodVertexCounts, int maxLods = 3);
+	}
+}
@@ -0,0 +1,178 @@
+#include "pch.h"
+#include "Meshlet.h"
+
+
+namespace
+{
+	//Cosine of the largest angle between a face and the average normal of its meshlet, about 75 degrees
+	//Wider cones are almost never back facing as a whole, so a turning surface is split into narrower meshlets
+	constexpr float g_MinConeDot{ 0.25f };
+
+	//Face normal flipped to agree with the authored vertex normals so the winding convention does not matter, zero for degenerate triangles
+	dae::Vector3 GetFaceNormal(const std::vector<dae::Vertex>& vertices, const uint32_t* pTriangle)
+	{
+		using namespace dae;
+
+		const Vertex& v0{ vertices[pTriangle[0]] };
+		const Vertex& v1{ vertices[pTriangle[1]] };
+		const Vertex& v2{ vertices[pTriangle[2]] };
+
+		Vector3 faceNormal{ Vector3::Cross(v1.position - v0.position, v2.position - v0.position) };
+
+		const float length{ faceNormal.Magnitude() };
+
+		if (length <= FLT_EPSILON)
+			return Vector3{};
+
+		faceNormal = faceNormal / length;
+
+		if (Vector3::Dot(faceNormal, v0.normal + v1.normal + v2.normal) < 0.f)
+			faceNormal = -faceNormal;
+
+		return faceNormal;
+	}
+
+	void ComputeBounds(dae::Meshlet& meshlet, const std::vector<dae::Vertex>& vertices, const std::vector<uint32_t>& indices, const std::vector<uint32_t>& meshletVertices)
+	{
+		using namespace dae;
+
+		//Bounding sphere around the vertex centroid, not minimal but cheap and tight enough for clusters
+		Vector3 center{};
+
+		for (uint32_t i{}; i < meshlet.nrVertices; ++i)
+			center += vertices[meshletVertices[meshlet.firstVertex + i]].position;
+
+		center = center / static_cast<float>(meshlet.nrVertices);
+
+		float radius{};
+
+		for (uint32_t i{}; i < meshlet.nrVertices; ++i)
+			radius = std::max(radius, (vertices[meshletVertices[meshlet.firstVertex + i]].position - center).Magnitude());
+
+		meshlet.center = center;
+		meshlet.radius = radius;
+
+
+		std::vector<Vector3> faceNormals{};
+		faceNormals.reserve(meshlet.nrTriangles);
+
+		Vector3 axis{};
+
+		for (uint32_t triangleIdx{ meshlet.firstTriangle }; triangleIdx < meshlet.firstTriangle + meshlet.nrTriangles; ++triangleIdx)
+		{
+			const Vector3 faceNormal{ GetFaceNormal(vertices, indices.data() + triangleIdx * 3) };
+
+			if (faceNormal.SqrMagnitude() <= 0.f)
+				continue;
+
+			faceNormals.emplace_back(faceNormal);
+			axis += faceNormal;
+		}
+
+		const float axisLength{ axis.Magnitude() };
+
+		if (faceNormals.empty() || axisLength <= FLT_EPSILON)
+			return;
+
+		axis = axis / axisLength;
+
+		float minDot{ 1.f };
+
+		for (const Vector3& faceNormal : faceNormals)
+			minDot = std::min(minDot, Vector3::Dot(axis, faceNormal));
+
+		//A cone of 90 degrees or wider always has a face pointing towards the camera
+		if (minDot <= 0.f)
+			return;
+
+		meshlet.coneAxis = axis;
+		meshlet.coneCutoff = std::sqrt(1.f - minDot * minDot);
+	}
+}
+
+
+void dae::Meshlet::Build(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, std::vector<Meshlet>& meshlets, std::vector<uint32_t>& meshletVertices)
+{
+	meshlets.clear();
+	meshletVertices.clear();
+
+	const uint32_t nrTriangles{ static_cast<uint32_t>(indices.size() / 3) };
+
+	if (nrTriangles == 0)
+		return;
+
+
+	// Index of the last meshlet each vertex was added to, so membership needs no reset between meshlets
+	std::vector<uint32_t> lastMeshlet(vertices.size(), UINT32_MAX);
+
+	Meshlet meshlet{};
+
+	//Sum of the oriented face normals so far, the axis the normal cone of the meshlet will get
+	Vector3 normalSum{};
+
+	const auto finishMeshlet = [&]()
+		{
+			normalSum = Vector3{};
+
+			ComputeBounds(meshlet, vertices, indices, meshletVertices);
+			meshlets.emplace_back(meshlet);
+
+			meshlet = Meshlet{};
+			meshlet.firstTriangle = meshlets.back().firstTriangle + meshlets.back().nrTriangles;
+			meshlet.firstVertex = static_cast<uint32_t>(meshletVertices.size());
+		};
+
+	for (uint32_t triangleIdx{}; triangleIdx < nrTriangles; ++triangleIdx)
+	{
+		const uint32_t* pTriangle{ indices.data() + triangleIdx * 3 };
+		const uint32_t meshletIdx{ static_cast<uint32_t>(meshlets.size()) };
+
+		uint32_t nrNewVertices{};
+
+		for (int corner{}; corner < 3; ++corner)
+		{
+			const bool isRepeated{ (corner > 0 && pTriangle[corner] == pTriangle[0]) || (corner > 1 && pTriangle[corner] == pTriangle[1]) };
+
+			if (!isRepeated && lastMeshlet[pTriangle[corner]] != meshletIdx)
+				++nrNewVertices;
+		}
+
+		const Vector3 faceNormal{ GetFaceNormal(vertices, pTriangle) };
+
+		//A face turned far from the others makes the cone too wide to cull, it starts the next meshlet instead
+		const bool isOutsideCone{ normalSum.SqrMagnitude() > 0.f && Vector3::Dot(normalSum.Normalized(), faceNormal) < g_MinConeDot };
+
+		if (meshlet.nrVertices + nrNewVertices > MaxVertices || meshlet.nrTriangles + 1 > MaxTriangles || isOutsideCone)
+			finishMeshlet();
+
+		normalSum += faceNormal;
+
+		const uint32_t currentMeshletIdx{ static_cast<uint32_t>(meshlets.size()) };
+
+		for (int corner{}; corner < 3; ++corner)
+		{
+			if (lastMeshlet[pTriangle[corner]] == currentMeshletIdx)
+				continue;
+
+			lastMeshlet[pTriangle[corner]] = currentMeshletIdx;
+			meshletVertices.emplace_back(pTriangle[corner]);
+			++meshlet.nrVertices;
+		}
+
+		++meshlet.nrTriangles;
+	}
+
+	if (meshlet.nrTriangles > 0)
+		finishMeshlet();
+}
+
+bool dae::Meshlet::IsBackFacing(const Vector3& cameraPosition) const
+{
+	if (coneCutoff >= 1.f)
+		return false;
+
+	const Vector3 toCenter{ center - cameraPosition };
+
+	// The whole cone points away even seen from the nearest point of the bounding sphere
+	return Vector3::Dot(toCenter, coneAxis) >= coneCutoff * toCenter.Magnitude() + radius;
+}
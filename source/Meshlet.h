@@ -0,0 +1,40 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "DataTypes.h"
+
+
+namespace dae
+{
+	// A small cluster of consecutive triangles of a triangle list, culled as a whole
+	struct Meshlet
+	{
+		static constexpr uint32_t MaxVertices{ 64 };
+		static constexpr uint32_t MaxTriangles{ 124 };
+
+		// Triangles [firstTriangle, firstTriangle + nrTriangles) of the index list
+		uint32_t firstTriangle{};
+		uint32_t nrTriangles{};
+
+		// Range in the meshlet vertex list of the mesh, every vertex the triangles use appears once
+		uint32_t firstVertex{};
+		uint32_t nrVertices{};
+
+		// Object space bounding sphere
+		Vector3 center{};
+		float radius{};
+
+		// Every outward face normal lies in the cone around coneAxis, coneCutoff is the sine of its half angle
+		// A cutoff of 1 means the cone is too wide to ever be back facing as a whole
+		Vector3 coneAxis{};
+		float coneCutoff{ 1.f };
+
+		// Greedy partition in index order, so the triangles of a meshlet stay consecutive
+		// A meshlet also ends where the surface turns too far for its normal cone to ever be back facing
+		static void Build(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, std::vector<Meshlet>& meshlets, std::vector<uint32_t>& meshletVertices);
+
+		// Both tests work in object space, the camera position has to be transformed into it
+		bool IsBackFacing(const Vector3& cameraPosition) const;
+	};
+}
@@ -0,0 +1,197 @@
+#include "pch.h"
+#include "OcclusionCuller.h"
+#include "Mesh.h"
+#include "MeshInstance.h"
+
+
+namespace
+{
+	// Vertices closer than this in view space are treated as crossing the near plane
+	constexpr float g_MinW{ 1e-3f };
+}
+
+
+dae::OcclusionCuller::OcclusionCuller(int screenWidth, int screenHeight)
+	: m_Height{ std::max(1, m_Width * screenHeight / screenWidth) }
+{
+	m_Depth.resize(m_Width * m_Height);
+}
+
+const std::vector<dae::MeshInstance*>& dae::OcclusionCuller::Cull(const std::vector<MeshInstance*>& pInstances, const Camera& camera)
+{
+	m_pVisibleInstances.clear();
+
+	if (!m_IsEnabled)
+	{
+		for (MeshInstance* pInstance : pInstances)
+		{
+			if (pInstance->IsActive())
+				m_pVisibleInstances.emplace_back(pInstance);
+		}
+
+		return m_pVisibleInstances;
+	}
+
+
+	const Matrix viewProjectionMatrix{ camera.GetViewMatrix() * camera.GetProjectionMatrix() };
+
+	std::fill(m_Depth.begin(), m_Depth.end(), 1.f);
+
+	for (const MeshInstance* pInstance : pInstances)
+	{
+		if (pInstance->IsActive() && pInstance->IsOccluder())
+			RasterizeOccluder(pInstance->GetMesh(), pInstance->GetWorldMatrix() * viewProjectionMatrix);
+	}
+
+	for (MeshInstance* pInstance : pInstances)
+	{
+		if (pInstance->IsActive() && IsVisible(pInstance->GetMesh(), pInstance->GetWorldMatrix() * viewProjectionMatrix))
+			m_pVisibleInstances.emplace_back(pInstance);
+	}
+
+	return m_pVisibleInstances;
+}
+
+void dae::OcclusionCuller::SetEnabled(bool isEnabled)
+{
+	m_IsEnabled = isEnabled;
+}
+
+bool dae::OcclusionCuller::IsEnabled() const
+{
+	return m_IsEnabled;
+}
+
+void dae::OcclusionCuller::RasterizeOccluder(const Mesh* pMesh, const Matrix& worldViewProjectionMatrix)
+{
+	const std::vector<uint32_t>& indices{ pMesh->GetIndices() };
+
+	m_VerticesNdc.resize(pMesh->GetVertexCount());
+
+	for (uint32_t vertexIdx{}; vertexIdx < pMesh->GetVertexCount(); ++vertexIdx)
+	{
+		Vector4 vertex{ worldViewProjectionMatrix.TransformPoint(Vector4{ pMesh->GetPosition(vertexIdx), 1.f }) };
+
+		if (vertex.w > g_MinW)
+		{
+			const float invW{ 1.f / vertex.w };
+			vertex.x = (vertex.x * invW + 1.f) * 0.5f * m_Width;
+			vertex.y = (1.f - vertex.y * invW) * 0.5f * m_Height;
+			vertex.z *= invW;
+		}
+
+		m_VerticesNdc[vertexIdx] = vertex;
+	}
+
+
+	for (size_t idx{}; idx + 2 < indices.size(); idx += 3)
+	{
+		const Vector4& v0{ m_VerticesNdc[indices[idx]] };
+		const Vector4& v1{ m_VerticesNdc[indices[idx + 1]] };
+		const Vector4& v2{ m_VerticesNdc[indices[idx + 2]] };
+
+		//Clipping is not worth it here, skipping a triangle only makes the buffer less effective
+		if (v0.w <= g_MinW || v1.w <= g_MinW || v2.w <= g_MinW)
+			continue;
+
+		//The farthest vertex bounds the whole triangle, which keeps the depth conservative
+		const float triangleDepth{ std::max(v0.z, std::max(v1.z, v2.z)) };
+
+		if (triangleDepth < 0.f || triangleDepth > 1.f)
+			continue;
+
+		const int minX{ std::max(0, static_cast<int>(std::floor(std::min(v0.x, std::min(v1.x, v2.x))))) };
+		const int minY{ std::max(0, static_cast<int>(std::floor(std::min(v0.y, std::min(v1.y, v2.y))))) };
+		const int maxX{ std::min(m_Width, static_cast<int>(std::ceil(std::max(v0.x, std::max(v1.x, v2.x))))) };
+		const int maxY{ std::min(m_Height, static_cast<int>(std::ceil(std::max(v0.y, std::max(v1.y, v2.y))))) };
+
+		const Vector2 p0{ v0.x, v0.y };
+		const Vector2 edge01{ Vector2{ v1.x, v1.y } - p0 };
+		const Vector2 edge12{ Vector2{ v2.x, v2.y } - Vector2{ v1.x, v1.y } };
+		const Vector2 edge20{ p0 - Vector2{ v2.x, v2.y } };
+
+		// Either winding, a coarse pixel is written only when all four of its corners are inside
+		const auto getSide = [&](float x, float y)
+			{
+				const Vector2 point{ x, y };
+				const float e0{ Vector2::Cross(point - p0, edge01) };
+				const float e1{ Vector2::Cross(point - Vector2{ v1.x, v1.y }, edge12) };
+				const float e2{ Vector2::Cross(point - Vector2{ v2.x, v2.y }, edge20) };
+
+				if (e0 >= 0.f && e1 >= 0.f && e2 >= 0.f) return 1;
+				if (e0 <= 0.f && e1 <= 0.f && e2 <= 0.f) return -1;
+				return 0;
+			};
+
+		for (int py{ minY }; py < maxY; ++py)
+		{
+			for (int px{ minX }; px < maxX; ++px)
+			{
+				const float x{ static_cast<float>(px) };
+				const float y{ static_cast<float>(py) };
+
+				const int side{ getSide(x, y) };
+
+				if (side == 0 || getSide(x + 1.f, y) != side || getSide(x, y + 1.f) != side || getSide(x + 1.f, y + 1.f) != side)
+					continue;
+
+				float& storedDepth{ m_Depth[px + py * m_Width] };
+				storedDepth = std::min(storedDepth, triangleDepth);
+			}
+		}
+	}
+}
+
+bool dae::OcclusionCuller::IsVisible(const Mesh* pMesh, const Matrix& worldViewProjectionMatrix) const
+{
+	const Vector3& boundsMin{ pMesh->GetBoundsMin() };
+	const Vector3& boundsMax{ pMesh->GetBoundsMax() };
+
+	float minX{ FLT_MAX }, minY{ FLT_MAX }, minDepth{ FLT_MAX };
+	float maxX{ -FLT_MAX }, maxY{ -FLT_MAX };
+
+	for (int corner{}; corner < 8; ++corner)
+	{
+		const Vector3 position{
+			(corner & 1) ? boundsMax.x : boundsMin.x,
+			(corner & 2) ? boundsMax.y : boundsMin.y,
+			(corner & 4) ? boundsMax.z : boundsMin.z };
+
+		const Vector4 vertex{ worldViewProjectionMatrix.TransformPoint(Vector4{ position, 1.f }) };
+
+		//Bounds crossing the near plane have no usable screen rectangle
+		if (vertex.w <= g_MinW)
+			return true;
+
+		const float invW{ 1.f / vertex.w };
+		const float x{ (vertex.x * invW + 1.f) * 0.5f * m_Width };
+		const float y{ (1.f - vertex.y * invW) * 0.5f * m_Height };
+
+		minX = std::min(minX, x);
+		minY = std::min(minY, y);
+		maxX = std::max(maxX, x);
+		maxY = std::max(maxY, y);
+		minDepth = std::min(minDepth, vertex.z * invW);
+	}
+
+	const int rectMinX{ std::max(0, static_cast<int>(std::floor(minX))) };
+	const int rectMinY{ std::max(0, static_cast<int>(std::floor(minY))) };
+	const int rectMaxX{ std::min(m_Width - 1, static_cast<int>(std::floor(maxX))) };
+	const int rectMaxY{ std::min(m_Height - 1, static_cast<int>(std::floor(maxY))) };
+
+	//Entirely off screen
+	if (rectMinX > rectMaxX || rectMinY > rectMaxY)
+		return false;
+
+	//Visible as soon as one coarse pixel has nothing in front of the nearest point of the bounds
+	for (int py{ rectMinY }; py <= rectMaxY; ++py)
+	{
+		for (int px{ rectMinX }; px <= rectMaxX; ++px)
+		{
+			if (m_Depth[px + py * m_Width] >= minDepth)
+				return true;
+		}
+	}
+
+	return false;
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include <vector>
+
+#include "Camera.h"
+
+
+namespace dae
+{
+	class Mesh;
+	class MeshInstance;
+
+	// Coarse occlusion culling shared by both rasterizers
+	// Occluder instances are rasterized into a small conservative depth buffer, every instance tests its screen bounds against it
+	class OcclusionCuller final
+	{
+	public:
+		OcclusionCuller(int screenWidth, int screenHeight);
+		~OcclusionCuller() = default;
+
+		OcclusionCuller(const OcclusionCuller&) = delete;
+		OcclusionCuller(OcclusionCuller&&) noexcept = delete;
+		OcclusionCuller& operator=(const OcclusionCuller&) = delete;
+		OcclusionCuller& operator=(OcclusionCuller&&) noexcept = delete;
+
+		// Returns the active instances that can be visible this frame in their original order, valid until the next call
+		const std::vector<MeshInstance*>& Cull(const std::vector<MeshInstance*>& pInstances, const Camera& camera);
+
+		void SetEnabled(bool isEnabled);
+		bool IsEnabled() const;
+
+	private:
+
+		static constexpr int m_Width{ 128 };
+		int m_Height{};
+
+		bool m_IsEnabled{ true };
+
+		// NDC depth, every value is at or behind the real occluder surface
+		std::vector<float> m_Depth{};
+		std::vector<Vector4> m_VerticesNdc{};
+
+		std::vector<MeshInstance*> m_pVisibleInstances{};
+
+		void RasterizeOccluder(const Mesh* pMesh, const Matrix& worldViewProjectionMatrix);
+		bool IsVisible(const Mesh* pMesh, const Matrix& worldViewProjectionMatrix) const;
+	};
+}
@@ -0,0 +1,116 @@
+#pragma once
+#include <cstdint>
+
+
+namespace dae
+{
+	// Maps pixel coordinates to an index in the internal color and depth buffers
+	// Tiled and Morton keep every screen tile contiguous in memory, the resolve swizzles them back to linear
+	struct PixelLayout
+	{
+		enum class Mode
+		{
+			Linear,
+			Tiled,
+			Morton,
+
+			COUNT
+		};
+
+		Mode mode{ Mode::Linear };
+
+		int width{};
+		int height{};
+		int nrTilesX{};
+		int nrTilesY{};
+
+		// Tiles are square with a power of two size
+		int tileShift{};
+		int tileMask{};
+
+		// Samples of one pixel are stored next to each other
+		static constexpr int MaxSampleCount{ 4 };
+		int sampleCount{ 1 };
+
+		PixelLayout() = default;
+
+		PixelLayout(int _width, int _height, int tileSize)
+			: width{ _width }
+			, height{ _height }
+			, nrTilesX{ (_width + tileSize - 1) / tileSize }
+			, nrTilesY{ (_height + tileSize - 1) / tileSize }
+			, tileMask{ tileSize - 1 }
+		{
+			while ((1 << tileShift) < tileSize)
+				++tileShift;
+		}
+
+		// Edge tiles are padded to full size, so the buffers can be a bit bigger than width * height
+		int GetBufferSize() const
+		{
+			return nrTilesX * nrTilesY << (2 * tileShift);
+		}
+
+		int GetSampleBufferSize() const
+		{
+			return GetBufferSize() * sampleCount;
+		}
+
+		bool IsTileContiguous() const
+		{
+			return mode != Mode::Linear;
+		}
+
+		int GetTileStart(int tileIdx) const
+		{
+			return tileIdx << (2 * tileShift);
+		}
+
+		int ToIndex(int px, int py) const
+		{
+			if (mode == Mode::Linear)
+				return px + py * width;
+
+			const int tileIdx{ (px >> tileShift) + (py >> tileShift) * nrTilesX };
+			const int localX{ px & tileMask };
+			const int localY{ py & tileMask };
+
+			if (mode == Mode::Tiled)
+				return GetTileStart(tileIdx) + (localY << tileShift) + localX;
+
+			return GetTileStart(tileIdx) + static_cast<int>(SpreadBits(static_cast<uint32_t>(localX)) | (SpreadBits(static_cast<uint32_t>(localY)) << 1));
+		}
+
+		int ToSampleIndex(int pixelIdx, int sample) const
+		{
+			return pixelIdx * sampleCount + sample;
+		}
+
+		// Rotated grid of D3D 4x MSAA in 1/16th pixel steps, relative to the pixel coordinate
+		static Vector2 GetSampleOffset(int sampleCount, int sample)
+		{
+			constexpr float offsets[MaxSampleCount][2]{ { -2.f, -6.f }, { 6.f, -2.f }, { -6.f, 2.f }, { 2.f, 6.f } };
+
+			if (sampleCount == 1)
+				return Vector2{};
+
+			return Vector2{ offsets[sample][0] / 16.f, offsets[sample][1] / 16.f };
+		}
+
+		// Furthest a sample lies from its pixel coordinate on either axis
+		static float GetSampleExtent(int sampleCount)
+		{
+			return sampleCount == 1 ? 0.f : 6.f / 16.f;
+		}
+
+		// Inserts a zero bit between every bit of a 16 bit value
+		static uint32_t SpreadBits(uint32_t value)
+		{
+			value = (value | (value << 8)) & 0x00FF00FF;
+			value = (value | (value << 4)) & 0x0F0F0F0F;
+			value = (value | (value << 2)) & 0x33333333;
+			value = (value | (value << 1)) & 0x55555555;
+			return value;
+		}
+	};
+}
@@ -25,14 +25,20 @@ namespace dae {
 		m_pHardwareRasterizer = new HardwareRasterizer{ pWindow };
 		m_pSoftwareRasterizer = new SoftwareRasterizer{ pWindow };
 
+		m_pOcclusionCuller = new OcclusionCuller{ m_Width, m_Height };
+
 
 		std::cout << "[SHARED KEY BINDINGS]" << '\n';
 		std::cout << "[F1]  Toggle Rasterizer Mode (HARDWARE / SOFTWARE)" << '\n';
 		std::cout << "[F2]  Toggle Vehicle Rotation (ON / OFF)" << '\n';
+		std::cout << "[I]   Toggle Vehicle Crowd (ON / OFF)" << '\n';
 		std::cout << "[F3]  Toggle FireFX (ON / OFF)" << '\n';
 		std::cout << "[F9]  Cycle CullModes (BACK / FRONT / NONE)" << '\n';
 		std::cout << "[F10] Toggle Uniform ClearColor (ON / OFF)" << "\n";
 		std::cout << "[F11] Toggle Print FPS (ON / OFF)" << "\n";
+		std::cout << "[K]   Toggle Occlusion Culling (ON / OFF)" << "\n";
+		std::cout << "[J]   Toggle Mesh LODs (ON / OFF)" << "\n";
+		std::cout << "[U]   Toggle Skipping Unchanged Frames (ON / OFF)" << "\n";
 
 		std::cout << "\n";
 		std::cout << "\n";
@@ -48,17 +54,27 @@ namespace dae {
 		std::cout << "[F6]  Toggle NormalMap (ON / OFF)" << "\n";
 		std::cout << "[F7]  Toggle DepthBuffer Visualization (ON / OFF)" << "\n";
 		std::cout << "[F8]  Toggle BoundingBox Visualization (ON / OFF)" << "\n";
-		std::cout << "[G]  Cycle Color Shading Modes (GAMMA / MAX_TO_POINT / FILMIC )" << "\n";
+		std::cout << "[F]  Toggle FXAA (ON / OFF)" << "\n";
+		std::cout << "[G]  Cycle Color Shading Modes (GAMMA / MAX_TO_POINT / REINHARD / FILMIC / ACES )" << "\n";
 
 		std::cout << "[Up arrow]  Increases Gamma Correction" << "\n";
 		std::cout << "[Down arrow]  Decreases Gamma Correction" << "\n";
+		std::cout << "[Z]  Cycle Depth Formats (FLOAT32 / UNORM24 / UNORM16)" << "\n";
+		std::cout << "[X]  Toggle Reversed Z (ON / OFF)" << "\n";
+		std::cout << "[C]  Toggle Depth Tile Compression (ON / OFF)" << "\n";
+		std::cout << "[V]  Cycle Framebuffer Layouts (LINEAR / TILED / MORTON)" << "\n";
+		std::cout << "[M]  Toggle 4x Multisampling (ON / OFF)" << "\n";
+		std::cout << "[O]  Toggle Order Independent Transparency (ON / OFF)" << "\n";
+		std::cout << "[P]  Toggle Depth Prepass (ON / OFF)" << "\n";
+		std::cout << "[L]  Toggle Meshlet Culling (ON / OFF)" << "\n";
+		std::cout << "[T]  Toggle Redrawing Only Changed Tiles (ON / OFF)" << "\n";
 
 
 		std::cout << "\n";
 		std::cout << "\n";
 
 		std::cout << "Extra's: Transparency, Gamma Correction and MultiThreading are added to the Software Rasterizer" << "\n";
-		std::cout << "Also an attempt to Filmic ToneMapping has been added to the Software Rasterizer" << "\n";
+		std::cout << "Also Reinhard, Filmic (Hable) and ACES ToneMapping have been added to the Software Rasterizer" << "\n";
 
 		std::cout << "\n";
 		std::cout << "\n";
@@ -66,89 +82,203 @@ namespace dae {
 
 
 
-		//Vehicle 
+		//Assets load on worker threads, the scene fills in as they arrive
+		//Meshes are drawn with flat placeholder maps until their own maps are loaded
 
 		ID3D11Device* pDevice{ m_pHardwareRasterizer->GetDevice() };
 
-		EffectShader* pVehicleEffect = new EffectShader(pDevice, L"Resources/Shader3D.fx");
+		m_pAssetCache = new AssetCache{ pDevice };
+
+		m_pPlaceholderMaps[0] = Texture::CreateSolidColor(pDevice, 128, 128, 128, 255);
+		m_pPlaceholderMaps[1] = Texture::CreateSolidColor(pDevice, 128, 128, 255, 255);
+		m_pPlaceholderMaps[2] = Texture::CreateSolidColor(pDevice, 0, 0, 0, 255);
+		m_pPlaceholderMaps[3] = Texture::CreateSolidColor(pDevice, 0, 0, 0, 255);
+		m_pTransparentPlaceholderMap = Texture::CreateSolidColor(pDevice, 0, 0, 0, 0);
+
+
+		//Vehicle 
+
+		PendingMesh vehicle{};
+		vehicle.mesh = m_pAssetCache->LoadMeshAsync<EffectShader>("Resources/vehicle.obj", L"Resources/Shader3D.fx", Mesh::VertexFormat::Compressed);
+
+		//Block compressed, the normal map keeps only x and y
+		vehicle.maps[0] = m_pAssetCache->LoadTextureAsync("Resources/vehicle_diffuse.png", TextureContainer::Format::BC1);
+		vehicle.maps[1] = m_pAssetCache->LoadTextureAsync("Resources/vehicle_normal.png", TextureContainer::Format::BC5);
+		vehicle.maps[2] = m_pAssetCache->LoadTextureAsync("Resources/vehicle_specular.png", TextureContainer::Format::BC1);
+		vehicle.maps[3] = m_pAssetCache->LoadTextureAsync("Resources/vehicle_gloss.png", TextureContainer::Format::BC1);
+
+		vehicle.onLoaded = [this](Mesh* pMesh)
+			{
+				MeshInstance* pInstance = new MeshInstance{ pMesh };
+				pInstance->SetOccluder(true);
 
-		Mesh* tempMesh = new Mesh{ pDevice, "Resources/vehicle.obj", pVehicleEffect };
+				AddInstance(pInstance);
 
-		tempMesh->SetDiffuseMap(Texture::LoadFromFile(pDevice, "Resources/vehicle_diffuse.png"));
-		tempMesh->SetNormalMap(Texture::LoadFromFile(pDevice, "Resources/vehicle_normal.png"));
-		tempMesh->SetSpecularMap(Texture::LoadFromFile(pDevice, "Resources/vehicle_specular.png"));
-		tempMesh->SetGlossinessMap(Texture::LoadFromFile(pDevice, "Resources/vehicle_gloss.png"));
 
+				//Crowd behind the vehicle, all sharing its geometry and textures
+				constexpr int crowdColumns{ 9 };
+				constexpr int crowdRows{ 8 };
 
-		m_pMeshes.emplace_back(tempMesh);
+				const Vector3 crowdSpacing{ (pMesh->GetBoundsMax() - pMesh->GetBoundsMin()) * 1.25f };
+
+				for (int row{ 1 }; row <= crowdRows; ++row)
+				{
+					for (int column{ -crowdColumns / 2 }; column <= crowdColumns / 2; ++column)
+					{
+						pInstance = new MeshInstance{ pMesh, Matrix::CreateTranslation(column * crowdSpacing.x, 0.f, row * crowdSpacing.z) };
+						pInstance->SetActive(false);
+
+						AddInstance(pInstance);
+						m_pCrowdInstances.emplace_back(pInstance);
+					}
+				}
+			};
+
+		m_PendingMeshes.emplace_back(std::move(vehicle));
 
 
 		//////////Fire Combustion
 
-		EffectTransparant* pCombustionEffect = new EffectTransparant(pDevice, L"Resources/Transparent3D.fx");
+		PendingMesh fire{};
+		fire.mesh = m_pAssetCache->LoadMeshAsync<EffectTransparant>("Resources/fireFx.obj", L"Resources/Transparent3D.fx", Mesh::VertexFormat::Compressed);
 
-		tempMesh = new Mesh{ pDevice, "Resources/fireFx.obj", pCombustionEffect };
+		fire.maps[0] = m_pAssetCache->LoadTextureAsync("Resources/fireFX_diffuse.png", TextureContainer::Format::BC3);
 
-		tempMesh->SetDiffuseMap(Texture::LoadFromFile(pDevice, "Resources/fireFX_diffuse.png"));
-		tempMesh->SetTransparent(true);
-		tempMesh->SetCullMode(Mesh::CullMode::None);
+		fire.onLoaded = [this](Mesh* pMesh)
+			{
+				pMesh->SetTransparent(true);
+				pMesh->SetCullMode(Mesh::CullMode::None);
 
-		m_pMeshes.emplace_back(tempMesh);
+				m_pFireInstance = new MeshInstance{ pMesh };
+				AddInstance(m_pFireInstance);
+			};
 
-		m_pFireMesh = tempMesh;
+		m_PendingMeshes.emplace_back(std::move(fire));
 
 
 	}
 
 	Renderer::~Renderer()
 	{
-		delete m_pHardwareRasterizer;
-		delete m_pSoftwareRasterizer;
+		//Loads that never reached the scene, the workers create D3D resources so they have to finish before the device goes
+		for (PendingMesh& pending : m_PendingMeshes)
+		{
+			if (!pending.pMesh)
+				m_pAssetCache->Release(pending.mesh.get());
+
+			for (std::future<Texture*>& map : pending.maps)
+			{
+				if (map.valid())
+					m_pAssetCache->Release(map.get());
+			}
+		}
+
+		m_PendingMeshes.clear();
 
 		//delete m_pCamera;
 
+		for (MeshInstance* pInstance : m_pInstances)
+		{
+			delete pInstance;
+		}
+
 		for (Mesh* pMesh : m_pMeshes)
 		{
-			delete pMesh;
+			m_pAssetCache->Release(pMesh);
 		}
 
+		delete m_pAssetCache;
+
+		for (Texture* pPlaceholderMap : m_pPlaceholderMaps)
+			delete pPlaceholderMap;
+
+		delete m_pTransparentPlaceholderMap;
+
+		//Owns the device, so it goes after everything holding D3D resources
+		delete m_pHardwareRasterizer;
+		delete m_pSoftwareRasterizer;
+		delete m_pOcclusionCuller;
 	}
 
 	void Renderer::Update(const Timer* pTimer)
 	{
+		ResolvePendingMeshes();
+
+		const Matrix previousViewMatrix{ m_Camera.GetViewMatrix() };
 		m_Camera.Update(pTimer);
 
+		if (m_Camera.GetViewMatrix() != previousViewMatrix || (m_ShouldRotateMesh && !m_pInstances.empty()))
+			m_IsSceneChanged = true;
+
+		//LODs and sort orders only depend on what is checked above
+		if (!m_IsSceneChanged)
+			return;
+
 
 		constexpr float rotationSpeed{ 45.0f * TO_RADIANS };
 
-		for (Mesh* pMesh : m_pMeshes)
+		for (MeshInstance* pInstance : m_pInstances)
 		{
 			if (m_ShouldRotateMesh)
 			{
 				float rotationSpeedRadian = 1.f;
-				pMesh->SetWorldMatrix(Matrix::CreateRotationY(rotationSpeedRadian * pTimer->GetElapsed()) * pMesh->GetWorldMatrix());
+				pInstance->SetWorldMatrix(Matrix::CreateRotationY(rotationSpeedRadian * pTimer->GetElapsed()) * pInstance->GetWorldMatrix());
 			}
 
+			SelectLod(pInstance);
+		}
+
+		for (Mesh* pMesh : m_pMeshes)
+		{
 			pMesh->SetMatrices(m_Camera.GetViewMatrix() * m_Camera.GetProjectionMatrix(), m_Camera.GetInverseViewMatrix());
+
+			if (!pMesh->IsTransparent())
+				continue;
+
+			//Back to front order for blending, shared by both rasterizers and by every instance of the mesh at the same LOD
+			for (int lodLevel{}; lodLevel < pMesh->GetLodCount(); ++lodLevel)
+			{
+				const auto instanceIt{ std::find_if(m_pInstances.begin(), m_pInstances.end(),
+					[pMesh, lodLevel](const MeshInstance* pInstance) { return pInstance->GetMesh() == pMesh && pInstance->IsActive() && pInstance->GetLodLevel() == lodLevel; }) };
+
+				if (instanceIt != m_pInstances.end())
+					pMesh->SortTriangles((*instanceIt)->GetWorldMatrix() * m_Camera.GetViewMatrix(), lodLevel);
+			}
 		}
 	}
 
 
 	void Renderer::Render() 	{
+		//Hidden instances never reach either rasterizer
+		const std::vector<MeshInstance*>& pVisibleInstances{ m_pOcclusionCuller->Cull(m_pInstances, m_Camera) };
+
 		switch (m_CurrentRenderer)
 		{
 			case dae::Renderer::Rasterizers::Software:
 			{
-				m_pSoftwareRasterizer->SoftwareRender(m_pMeshes, m_Camera, m_IsBackgroundUniform);
+				m_pSoftwareRasterizer->SoftwareRender(pVisibleInstances, m_Camera, m_IsBackgroundUniform);
 				break;
 			}
 			case dae::Renderer::Rasterizers::Hardware:
 			{
-				m_pHardwareRasterizer->HardwareRender(m_pMeshes, m_IsBackgroundUniform);
+				m_pHardwareRasterizer->HardwareRender(pVisibleInstances, m_IsBackgroundUniform);
 				break;
 			}
 		}
+
+		m_IsSceneChanged = false;
+	}
+
+	bool Renderer::IsSceneChanged() const
+	{
+		return m_IsSceneChanged;
 	}
+
+	void Renderer::MarkSceneChanged()
+	{
+		m_IsSceneChanged = true;
+	}
+
 	void Renderer::NextRasterizerMode()
 	{
 		m_CurrentRenderer = static_cast<Rasterizers>((static_cast<int>(m_CurrentRenderer) + 1) % (static_cast<int>(Rasterizers::COUNT)));
@@ -176,12 +306,28 @@ namespace dae {
 			std::cout << "ROTATE MESH : False" << "\n";
 	}
 
+	void Renderer::ToggleVehicleCrowd()
+	{
+		const bool isCrowdActive{ !m_pCrowdInstances.empty() && !m_pCrowdInstances.front()->IsActive() };
+
+		for (MeshInstance* pInstance : m_pCrowdInstances)
+			pInstance->SetActive(isCrowdActive);
+
+		if (isCrowdActive)
+			std::cout << "VEHICLE CROWD : Enabled" << "\n";
+		else
+			std::cout << "VEHICLE CROWD : Disabled" << "\n";
+	}
+
 	void Renderer::ToggleFireMesh()
 	{
 
-		m_pFireMesh->SetActive(!m_pFireMesh->IsActive());
+		if (!m_pFireInstance)
+			return;
+
+		m_pFireInstance->SetActive(!m_pFireInstance->IsActive());
 
-		if (m_pFireMesh->IsActive())
+		if (m_pFireInstance->IsActive())
 			std::cout << "FIRE MESH : Enabled" << "\n";
 		else
 			std::cout << "FIRE MESH : Disabled" << "\n";
@@ -215,6 +361,7 @@ namespace dae {
 	void Renderer::ToggleCullMode()
 	{
 		m_CullMode = static_cast<Mesh::CullMode>((static_cast<int>(m_CullMode) + 1) % (static_cast<int>(Mesh::CullMode::COUNT)));
+		m_IsCullModeOverridden = true;
 
 		switch (m_CullMode)
 		{
@@ -234,6 +381,8 @@ namespace dae {
 			m_pMeshes[i]->SetCullMode(m_CullMode);
 			m_pHardwareRasterizer->NextCullingMode(m_pMeshes, m_CullMode);
 		}
+
+		m_pSoftwareRasterizer->InvalidateFrame();
 	}
 
 	void Renderer::ToggleUniformBackground()
@@ -256,4 +405,214 @@ namespace dae {
 		m_pSoftwareRasterizer->AdjustGammaCorrection(lowerIt);
 	}
 
+	void Renderer::NextDepthFormat()
+	{
+		m_pSoftwareRasterizer->NextDepthFormat();
+	}
+
+	void Renderer::ToggleReversedZ()
+	{
+		m_pSoftwareRasterizer->ToggleReversedZ();
+	}
+
+	void Renderer::ToggleDepthCompression()
+	{
+		m_pSoftwareRasterizer->ToggleDepthCompression();
+	}
+
+	void Renderer::NextPixelLayout()
+	{
+		m_pSoftwareRasterizer->NextPixelLayout();
+	}
+
+	void Renderer::ToggleMultisampling()
+	{
+		m_pSoftwareRasterizer->ToggleMultisampling();
+	}
+
+	void Renderer::ToggleFXAA()
+	{
+		m_pSoftwareRasterizer->ToggleFXAA();
+	}
+
+	void Renderer::ToggleOcclusionCulling()
+	{
+		m_pOcclusionCuller->SetEnabled(!m_pOcclusionCuller->IsEnabled());
+
+		if (m_pOcclusionCuller->IsEnabled())
+			std::cout << "OCCLUSION CULLING : Enabled" << "\n";
+		else
+			std::cout << "OCCLUSION CULLING : Disabled" << "\n";
+	}
+
+	void Renderer::ToggleLod()
+	{
+		m_IsLodEnabled = !m_IsLodEnabled;
+
+		if (m_IsLodEnabled)
+			std::cout << "MESH LODS : Enabled" << "\n";
+		else
+			std::cout << "MESH LODS : Disabled" << "\n";
+	}
+
+	void Renderer::ToggleDirtyTiles()
+	{
+		m_pSoftwareRasterizer->ToggleDirtyTiles();
+	}
+
+	void Renderer::ResolvePendingMeshes()
+	{
+		static constexpr void (Mesh::*setMapFunctions[])(Texture*)
+		{
+			&Mesh::SetDiffuseMap, &Mesh::SetNormalMap, &Mesh::SetSpecularMap, &Mesh::SetGlossinessMap
+		};
+
+		static constexpr Texture* (Mesh::*getMapFunctions[])() const
+		{
+			&Mesh::GetDiffuseMap, &Mesh::GetNormalMap, &Mesh::GetSpecularMap, &Mesh::GetGlossinessMap
+		};
+
+		const auto isReady = [](const auto& future)
+			{
+				return future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+			};
+
+		for (auto pendingIt{ m_PendingMeshes.begin() }; pendingIt != m_PendingMeshes.end();)
+		{
+			PendingMesh& pending{ *pendingIt };
+
+			if (!pending.pMesh)
+			{
+				if (!isReady(pending.mesh))
+				{
+					++pendingIt;
+					continue;
+				}
+
+				pending.pMesh = pending.mesh.get();
+				pending.onLoaded(pending.pMesh);
+
+				//Filter and cull mode changes made while the mesh was loading
+				m_pHardwareRasterizer->ApplyStates(pending.pMesh);
+
+				if (m_IsCullModeOverridden)
+					pending.pMesh->SetCullMode(m_CullMode);
+
+				m_IsSceneChanged = true;
+
+				for (size_t mapIndex{}; mapIndex < std::size(pending.maps); ++mapIndex)
+				{
+					if (!pending.maps[mapIndex].valid())
+						continue;
+
+					//A clear diffuse keeps a transparent mesh invisible instead of drawing a grey surface
+					Texture* pPlaceholderMap{ mapIndex == 0 && pending.pMesh->IsTransparent() ? m_pTransparentPlaceholderMap : m_pPlaceholderMaps[mapIndex] };
+					m_pAssetCache->SetMeshMap(pending.pMesh, setMapFunctions[mapIndex], getMapFunctions[mapIndex], pPlaceholderMap);
+				}
+
+				m_pMeshes.emplace_back(pending.pMesh);
+			}
+
+			bool isResolved{ true };
+
+			for (size_t mapIndex{}; mapIndex < std::size(pending.maps); ++mapIndex)
+			{
+				std::future<Texture*>& map{ pending.maps[mapIndex] };
+
+				if (!map.valid())
+					continue;
+
+				if (!isReady(map))
+				{
+					isResolved = false;
+					continue;
+				}
+
+				//A map that failed to load keeps its placeholder
+				if (Texture* pMap{ map.get() })
+				{
+					m_pAssetCache->SetMeshMap(pending.pMesh, setMapFunctions[mapIndex], getMapFunctions[mapIndex], pMap);
+					m_IsSceneChanged = true;
+
+					//The mesh did not move, so the software rasterizer would keep showing the placeholder
+					m_pSoftwareRasterizer->InvalidateFrame();
+				}
+			}
+
+			if (isResolved)
+				pendingIt = m_PendingMeshes.erase(pendingIt);
+			else
+				++pendingIt;
+		}
+	}
+
+	void Renderer::AddInstance(MeshInstance* pInstance)
+	{
+		//Transparent instances stay behind the opaque ones, instances of one mesh stay next to each other
+		auto instanceIt{ m_pInstances.end() };
+
+		if (!pInstance->GetMesh()->IsTransparent())
+		{
+			instanceIt = std::find_if(m_pInstances.begin(), m_pInstances.end(),
+				[](const MeshInstance* pOther) { return pOther->GetMesh()->IsTransparent(); });
+		}
+
+		m_pInstances.insert(instanceIt, pInstance);
+	}
+
+	void Renderer::SelectLod(MeshInstance* pInstance) const
+	{
+		if (!m_IsLodEnabled)
+		{
+			pInstance->SetLodLevel(0);
+			return;
+		}
+
+		const Mesh* pMesh{ pInstance->GetMesh() };
+
+		//World space bounding sphere around the object space box
+		const Matrix& worldMatrix{ pInstance->GetWorldMatrix() };
+
+		const Vector3 center{ worldMatrix.TransformPoint((pMesh->GetBoundsMin() + pMesh->GetBoundsMax()) / 2.f) };
+		const float scale{ std::max(std::max(worldMatrix.GetAxisX().Magnitude(), worldMatrix.GetAxisY().Magnitude()), worldMatrix.GetAxisZ().Magnitude()) };
+		const float radius{ (pMesh->GetBoundsMax() - pMesh->GetBoundsMin()).Magnitude() / 2.f * scale };
+
+		const float distance{ (center - m_Camera.GetOrigin()).Magnitude() };
+
+		if (distance <= radius)
+		{
+			pInstance->SetLodLevel(0);
+			return;
+		}
+
+		//Projected diameter as a fraction of the screen height, [1][1] of the projection is 1 / tan(fov / 2)
+		const float screenFraction{ radius * m_Camera.GetProjectionMatrix()[1][1] / distance };
+
+		int lodLevel{};
+		float threshold{ m_LodScreenFraction };
+
+		while (lodLevel < pMesh->GetLodCount() - 1 && screenFraction < threshold)
+		{
+			++lodLevel;
+			threshold *= 0.5f;
+		}
+
+		pInstance->SetLodLevel(lodLevel);
+	}
+
+	void Renderer::ToggleDepthPrepass()
+	{
+		m_pSoftwareRasterizer->ToggleDepthPrepass();
+	}
+
+	void Renderer::ToggleMeshletCulling()
+	{
+		m_pSoftwareRasterizer->ToggleMeshletCulling();
+	}
+
+	void Renderer::ToggleOIT()
+	{
+		m_pSoftwareRasterizer->ToggleOIT();
+	}
+
 }
@@ -1,8 +1,13 @@
 #pragma once
+#include <functional>
+#include <future>
 #include "Camera.h"
 #include "Mesh.h"
+#include "MeshInstance.h"
 #include "HardwareRasterizer.h"
 #include "SoftwareRasterizer.h"
+#include "OcclusionCuller.h"
+#include "AssetCache.h"
 
 
 struct SDL_Window;
@@ -24,9 +29,16 @@ namespace dae
 		void Update(const Timer* pTimer);
 		void Render() ;
 
+		// False while the frame on screen is still up to date, no camera movement, rotation, loaded asset or setting since the last Render
+		bool IsSceneChanged() const;
+
+		// Settings are changed from outside through the functions below, so the caller reports those
+		void MarkSceneChanged();
+
 		//SHARED
 		void NextRasterizerMode();
 		void ToggleRotateMesh();
+		void ToggleVehicleCrowd();
 
 		//HARDWARE
 		void ToggleFireMesh();
@@ -45,6 +57,20 @@ namespace dae
 		void ToggleColorShadingMode();
 		void AdjustGammaCorrection(bool lowerIt);
 
+		void NextDepthFormat();
+		void ToggleReversedZ();
+		void ToggleDepthCompression();
+		void NextPixelLayout();
+		void ToggleMultisampling();
+		void ToggleFXAA();
+		void ToggleOIT();
+		void ToggleDepthPrepass();
+		void ToggleMeshletCulling();
+
+		void ToggleOcclusionCulling();
+		void ToggleLod();
+		void ToggleDirtyTiles();
+
 	private:
 
 		enum class Rasterizers
@@ -58,11 +84,18 @@ namespace dae
 		Rasterizers m_CurrentRenderer{ Rasterizers::Hardware };
 		Mesh::CullMode m_CullMode;
 
+		// Meshes keep their own cull mode until it is cycled, from then on every mesh uses m_CullMode
+		bool m_IsCullModeOverridden{ false };
+
 		SDL_Window* m_pWindow{};
 		Camera m_Camera;
 
+		// Unique assets, every placement in the scene is an instance referencing one of them
 		std::vector<Mesh*> m_pMeshes;
-		Mesh* m_pFireMesh;
+		std::vector<MeshInstance*> m_pInstances;
+
+		MeshInstance* m_pFireInstance{};
+		std::vector<MeshInstance*> m_pCrowdInstances;
 
 		int m_Width{};
 		int m_Height{};
@@ -72,8 +105,43 @@ namespace dae
 		HardwareRasterizer* m_pHardwareRasterizer{};
 		SoftwareRasterizer* m_pSoftwareRasterizer{};
 
+		OcclusionCuller* m_pOcclusionCuller{};
+
+		AssetCache* m_pAssetCache{};
+
+		// A mesh whose file or maps are still loading on worker threads, it joins the scene as soon as its geometry is there
+		struct PendingMesh
+		{
+			std::future<Mesh*> mesh{};
+			Mesh* pMesh{ nullptr };
+
+			// Diffuse, normal, specular and glossiness, a map without a future is not used by the mesh
+			std::future<Texture*> maps[4]{};
+
+			// Places the instances of the mesh once it is loaded
+			std::function<void(Mesh*)> onLoaded{};
+		};
+
+		std::vector<PendingMesh> m_PendingMeshes{};
+
+		// Stand-ins for maps that are still loading, the same order as PendingMesh::maps
+		Texture* m_pPlaceholderMaps[4]{};
+		Texture* m_pTransparentPlaceholderMap{};
+
+		void ResolvePendingMeshes();
+		void AddInstance(MeshInstance* pInstance);
+
 		bool m_ShouldRotateMesh{ true };
 		bool m_IsBackgroundUniform{ false };
 
+		bool m_IsSceneChanged{ true };
+
+		bool m_IsLodEnabled{ true };
+
+		// A mesh drops one LOD each time its bounding sphere's screen height halves below this fraction of the screen
+		float m_LodScreenFraction{ 0.5f };
+
+		void SelectLod(MeshInstance* pInstance) const;
+
 	};
 }
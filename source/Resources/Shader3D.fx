@@ -7,8 +7,13 @@ float gLightIntensity = 7.f;
 float gShininess = 25.f;
 float3 gLightDirection = float3(0.577f, -0.577f, 0.577f);
 
-float4x4 gWorldViewProj : WorldViewProjection;
-float4x4 gWorldMatrix : WorldMatrix;
+float4x4 gViewProj : ViewProjection;
+
+//Compressed vertices store positions as fractions of the mesh bounds and octahedral normals
+//Full vertices use a min of 0 and an extent of 1
+bool gIsVertexCompressed = false;
+float3 gPositionMin = float3(0.f, 0.f, 0.f);
+float3 gPositionExtent = float3(1.f, 1.f, 1.f);
 float4x4 gInverseViewMatrix : ViewInverse;
 
 Texture2D gDiffuseMap : DiffuseMap;
@@ -53,6 +58,11 @@ struct VS_INPUT
 	float3 Normal : NORMAL;
 	float3 Tangent : TANGENT;
 
+	//Per instance
+	float4 World0 : WORLD0;
+	float4 World1 : WORLD1;
+	float4 World2 : WORLD2;
+	float4 World3 : WORLD3;
 };
 
 struct VS_OUTPUT
@@ -67,13 +77,25 @@ struct VS_OUTPUT
 //---------------
 //	Vertex Shader
 //---------------
+float3 DecodeOctahedral(float2 encoded)
+{
+	float3 direction = float3(encoded.x, encoded.y, 1.f - abs(encoded.x) - abs(encoded.y));
+	float fold = saturate(-direction.z);
+	direction.xy += (direction.xy >= 0.f) ? -fold : fold;
+	return normalize(direction);
+}
+
 VS_OUTPUT VS(VS_INPUT input)
 {
 	VS_OUTPUT output = (VS_OUTPUT)0;
-	output.Position = mul(float4(input.Position, 1.f), gWorldViewProj);
-	output.WorldPosition = mul(float4(input.Position, 1.f), gWorldMatrix);
-	output.Normal = mul(normalize(input.Normal), (float3x3)gWorldMatrix);
-	output.Tangent = mul(normalize(input.Tangent), (float3x3)gWorldMatrix);
+	float4x4 worldMatrix = float4x4(input.World0, input.World1, input.World2, input.World3);
+	float3 position = gPositionMin + input.Position * gPositionExtent;
+	float3 normal = gIsVertexCompressed ? DecodeOctahedral(input.Normal.xy) : normalize(input.Normal);
+	float3 tangent = gIsVertexCompressed ? DecodeOctahedral(input.Tangent.xy) : normalize(input.Tangent);
+	output.WorldPosition = mul(float4(position, 1.f), worldMatrix);
+	output.Position = mul(output.WorldPosition, gViewProj);
+	output.Normal = mul(normal, (float3x3)worldMatrix);
+	output.Tangent = mul(tangent, (float3x3)worldMatrix);
 	output.UV = input.UV;
 	return output;
 }
@@ -99,8 +121,9 @@ float4 PS(VS_OUTPUT input) : SV_TARGET
 {
 	float3 binormal = cross(input.Normal, input.Tangent);
 	float4x4 tangentSpaceAxis = float4x4(float4(input.Tangent, 0.f), float4(normalize(binormal), 0.f), float4(input.Normal, 0.f), float4(0.f, 0.f, 0.f, 0.f));
-	float3 sampledNormal = gNormalMap.Sample(gSampleState, input.UV).rgb;
-	sampledNormal = 2.f * sampledNormal - float3(1.f, 1.f, 1.f);
+	//z is rebuilt from the unit length, two channel (BC5) normal maps only store x and y
+	float2 sampledNormalXY = 2.f * gNormalMap.Sample(gSampleState, input.UV).rg - float2(1.f, 1.f);
+	float3 sampledNormal = float3(sampledNormalXY, sqrt(saturate(1.f - dot(sampledNormalXY, sampledNormalXY))));
 	sampledNormal = mul(float4(sampledNormal, 0.f), tangentSpaceAxis);
 	normalize(sampledNormal);
 
@@ -2,8 +2,13 @@
 //Global Variables
 //-------
 
-float4x4 gWorldViewProj : WorldViewProjection;
-float4x4 gWorldMatrix : WorldMatrix;
+float4x4 gViewProj : ViewProjection;
+
+//Compressed vertices store positions as fractions of the mesh bounds and octahedral normals
+//Full vertices use a min of 0 and an extent of 1
+bool gIsVertexCompressed = false;
+float3 gPositionMin = float3(0.f, 0.f, 0.f);
+float3 gPositionExtent = float3(1.f, 1.f, 1.f);
 float4x4 gInverseViewMatrix : InverseViewMatrix;
 
 Texture2D gDiffuseMap : DiffuseMap;
@@ -66,6 +71,11 @@ struct VS_INPUT
 	float3 Normal : NORMAL;
 	float3 Tangent : TANGENT;
 
+	//Per instance
+	float4 World0 : WORLD0;
+	float4 World1 : WORLD1;
+	float4 World2 : WORLD2;
+	float4 World3 : WORLD3;
 };
 
 struct VS_OUTPUT
@@ -80,7 +90,9 @@ struct VS_OUTPUT
 VS_OUTPUT VS(VS_INPUT input)
 {
 	VS_OUTPUT output = (VS_OUTPUT)0;
-	output.Position = mul(float4(input.Position, 1.f), gWorldViewProj);
+	float4x4 worldMatrix = float4x4(input.World0, input.World1, input.World2, input.World3);
+	float3 position = gPositionMin + input.Position * gPositionExtent;
+	output.Position = mul(mul(float4(position, 1.f), worldMatrix), gViewProj);
 	output.UV = input.UV;
 	return output;
 }
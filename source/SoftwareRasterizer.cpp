@@ -1,10 +1,15 @@
 #include "pch.h"
 #include "SoftwareRasterizer.h"
 #include "Mesh.h"
+#include "MeshInstance.h"
 #include "Texture.h"
 #include "Utils.h"
+#include "DepthBuffer.h"
+#include "FXAA.h"
 
 #include <ppl.h>
+#include <emmintrin.h>
+#include <bit>
 
 #define PARALLEL
 
@@ -22,15 +27,32 @@ dae::SoftwareRasterizer::SoftwareRasterizer(SDL_Window* pWindow)
 	m_pBackBufferPixels = (uint32_t*)m_pBackBuffer->pixels;
 
 
-	const int nrPixels{ m_Width * m_Height };
-	m_pDepthBufferPixels = new float[nrPixels];
-	std::fill_n(m_pDepthBufferPixels, nrPixels, FLT_MAX);
+	m_PixelLayout = PixelLayout{ m_Width, m_Height, m_TileSize };
 
+	m_pDepthBuffer = new DepthBuffer{ m_PixelLayout };
+
+	AllocateColorBuffer();
+
+	m_pFXAA = new FXAA{ m_Width, m_Height };
+
+
+	m_NrTilesX = (m_Width + m_TileSize - 1) / m_TileSize;
+	m_NrTilesY = (m_Height + m_TileSize - 1) / m_TileSize;
+
+	m_TileCleared.resize(m_NrTilesX * m_NrTilesY);
+	m_TileDirty.resize(m_NrTilesX * m_NrTilesY);
+	m_TileBins.resize(m_NrTilesX * m_NrTilesY);
+
+	UpdateToneMapper();
 }
 
 dae::SoftwareRasterizer::~SoftwareRasterizer()
 {
-	delete[] m_pDepthBufferPixels;
+	delete m_pDepthBuffer;
+	delete m_pFXAA;
+	delete[] m_pColorBufferPixels;
+	delete[] m_pAccumulationPixels;
+	delete[] m_pRevealagePixels;
 }
 
 void dae::SoftwareRasterizer::Update(Timer* pTimer)
@@ -39,15 +61,55 @@ void dae::SoftwareRasterizer::Update(Timer* pTimer)
 
 
 
-void dae::SoftwareRasterizer::SoftwareRender(std::vector<Mesh*>& pMeshes, Camera& camera, bool isBackgroundUniform) const
+void dae::SoftwareRasterizer::SoftwareRender(const std::vector<MeshInstance*>& pInstances, Camera& camera, bool isBackgroundUniform)
 {
-	ResetDepthBufferAndClearBackground(isBackgroundUniform);
+	UpdateDirtyTiles(pInstances, camera, isBackgroundUniform);
+	ResetTiles();
 	SDL_LockSurface(m_pBackBuffer);
 
-	for (auto& pMesh : pMeshes)
+	const auto renderBatches = [&](const auto& renderBatch)
+		{
+			for (size_t firstIdx{}; firstIdx < pInstances.size();)
+			{
+				const Mesh* pMesh{ pInstances[firstIdx]->GetMesh() };
+
+				size_t endIdx{ firstIdx + 1 };
+
+				while (endIdx < pInstances.size() && pInstances[endIdx]->GetMesh() == pMesh)
+					++endIdx;
+
+				renderBatch(pMesh, pInstances.data() + firstIdx, endIdx - firstIdx);
+				firstIdx = endIdx;
+			}
+		};
+
+	//The depth of every opaque instance goes in before any shading, so only the final visible surface gets shaded
+	const bool isDepthPrepassed{ m_IsDepthPrepassEnabled && m_RenderMode == RenderMode::Default && !m_IsShowingBoundingBoxes };
+
+	if (isDepthPrepassed)
+	{
+		renderBatches([&](const Mesh* pMesh, MeshInstance* const* ppInstances, size_t nrInstances)
+			{
+				if (!pMesh->IsTransparent())
+					Render(ppInstances, nrInstances, camera, RasterPass::Depth);
+			});
+	}
+
+	renderBatches([&](const Mesh* pMesh, MeshInstance* const* ppInstances, size_t nrInstances)
+		{
+			Render(ppInstances, nrInstances, camera, isDepthPrepassed && !pMesh->IsTransparent() ? RasterPass::Shade : RasterPass::Full);
+		});
+
+	if (m_RenderMode == RenderMode::Depth && !m_IsShowingBoundingBoxes)
+		VisualizeDepthBuffer();
+
+	const float clearValue{ isBackgroundUniform ? 0.1f : 0.39f };
+	ResolveColorBuffer(ColorRGB{ clearValue, clearValue, clearValue });
+
+	if (m_IsFXAAEnabled)
 	{
-		if (pMesh->IsActive())
-			Render(pMesh, camera);
+		const SDL_PixelFormat* pFormat{ m_pBackBuffer->format };
+		m_pFXAA->Apply(m_pBackBufferPixels, pFormat->Rshift, pFormat->Gshift, pFormat->Bshift, m_TileSize);
 	}
 
 	SDL_UnlockSurface(m_pBackBuffer);
@@ -86,57 +148,406 @@ bool dae::SoftwareRasterizer::CheckCullMode(const Mesh* pMesh, const float edge0
 	return false;
 }
 
-void dae::SoftwareRasterizer::VertexTransformationFunction(Mesh* pMesh, Camera& camera) const
+void dae::SoftwareRasterizer::VertexTransformationFunction(MeshInstance* const* ppInstances, size_t nrInstances, const Camera& camera) const
+{
+	//Vertices are split in chunks over every instance, so a batch of small instances still fills the cores
+	constexpr uint32_t chunkSize{ 1024 };
+
+	struct TransformChunk
+	{
+		uint32_t instanceIdx;
+		uint32_t firstVertex;
+	};
+
+	std::vector<TransformChunk> chunks{};
+	std::vector<Matrix> worldViewProjectionMatrices(nrInstances);
+
+	const Matrix projectionMatrix{ m_pDepthBuffer->IsReversedZ() ? camera.GetReversedProjectionMatrix() : camera.GetProjectionMatrix() };
+	const Matrix viewProjectionMatrix{ camera.GetViewMatrix() * projectionMatrix };
+
+	for (uint32_t instanceIdx{}; instanceIdx < nrInstances; ++instanceIdx)
+	{
+		MeshInstance* pInstance{ ppInstances[instanceIdx] };
+
+		if (!pInstance->IsActive())
+			continue;
+
+		const bool isMasked{ m_UsesMeshlets[instanceIdx] != 0 };
+
+		//A static instance seen from a static camera keeps last frame's positions, as long as the same vertices are masked out
+		MeshInstance::TransformCache& cache{ pInstance->GetTransformCache() };
+		const Mesh::CullMode cullMode{ pInstance->GetMesh()->GetCullMode() };
+
+		if (cache.arePositionsValid
+			&& cache.worldMatrix == pInstance->GetWorldMatrix()
+			&& cache.viewProjectionMatrix == viewProjectionMatrix
+			&& cache.lodLevel == pInstance->GetLodLevel()
+			&& cache.isMasked == isMasked
+			&& (!isMasked || cache.cullMode == cullMode))
+			continue;
+
+		cache.worldMatrix = pInstance->GetWorldMatrix();
+		cache.viewProjectionMatrix = viewProjectionMatrix;
+		cache.lodLevel = pInstance->GetLodLevel();
+		cache.isMasked = isMasked;
+		cache.cullMode = cullMode;
+		cache.arePositionsValid = true;
+		cache.areAttributesValid = false;
+		cache.arePositionsScreenValid = false;
+
+		//Coarser LODs only reference a prefix of the vertices, the rest is never transformed
+		const uint32_t nrVertices{ pInstance->GetDrawVertexCount() };
+		pInstance->GetPositionsOut().resize(nrVertices);
+
+		worldViewProjectionMatrices[instanceIdx] = pInstance->GetWorldMatrix() * viewProjectionMatrix;
+
+		for (uint32_t firstVertex{}; firstVertex < nrVertices; firstVertex += chunkSize)
+			chunks.emplace_back(TransformChunk{ instanceIdx, firstVertex });
+	}
+
+
+	concurrency::parallel_for(0, static_cast<int>(chunks.size()),
+		[&](int chunkIdx)
+		{
+			const TransformChunk& chunk{ chunks[chunkIdx] };
+
+			MeshInstance* pInstance{ ppInstances[chunk.instanceIdx] };
+
+			const Mesh* pMesh{ pInstance->GetMesh() };
+			std::vector<Vector4>& positionsOut{ pInstance->GetPositionsOut() };
+
+			const std::vector<uint8_t>* pVertexMask{ m_UsesMeshlets[chunk.instanceIdx] ? &m_VertexMasks[chunk.instanceIdx] : nullptr };
+
+			const Matrix& worldViewProjectionMatrix{ worldViewProjectionMatrices[chunk.instanceIdx] };
+
+			const uint32_t endVertex{ std::min(chunk.firstVertex + chunkSize, static_cast<uint32_t>(positionsOut.size())) };
+
+			for (uint32_t vertexIdx{ chunk.firstVertex }; vertexIdx < endVertex; ++vertexIdx)
+			{
+				//Vertices of culled meshlets are never referenced by a binned triangle
+				if (pVertexMask && !(*pVertexMask)[vertexIdx])
+					continue;
+
+				//Only the position is decoded, the attributes wait until the vertex is known to be shaded
+				Vector4 position{ worldViewProjectionMatrix.TransformPoint({ pMesh->GetPosition(vertexIdx), 1.0f }) };
+
+				const float invVInPosW{ 1.f / position.w };
+
+				position.x *= invVInPosW;
+				position.y *= invVInPosW;
+				position.z *= invVInPosW;
+
+				positionsOut[vertexIdx] = position;
+			}
+		});
+}
+
+
+void dae::SoftwareRasterizer::ComputeVertexAttributes(MeshInstance* pInstance, const Camera& camera) const
+{
+	constexpr int chunkSize{ 1024 };
+
+	const Mesh* pMesh{ pInstance->GetMesh() };
+	const Matrix& worldMatrix{ pInstance->GetWorldMatrix() };
+
+	std::vector<VertexAttributes_Out>& attributesOut{ pInstance->GetAttributesOut() };
+	attributesOut.resize(pInstance->GetPositionsOut().size());
+
+	const int nrVertices{ static_cast<int>(attributesOut.size()) };
+
+	concurrency::parallel_for(0, (nrVertices + chunkSize - 1) / chunkSize,
+		[&](int chunkIdx)
+		{
+			const int endVertex{ std::min((chunkIdx + 1) * chunkSize, nrVertices) };
+
+			for (int vertexIdx{ chunkIdx * chunkSize }; vertexIdx < endVertex; ++vertexIdx)
+			{
+				if (!m_ReferencedVertices[vertexIdx])
+					continue;
+
+				//Decoded here when the mesh stores compressed vertices
+				const Vertex vIn{ pMesh->GetVertex(vertexIdx) };
+
+				VertexAttributes_Out& vOut{ attributesOut[vertexIdx] };
+
+				vOut.uv = vIn.uv;
+				vOut.normal = worldMatrix.TransformVector(vIn.normal);
+				vOut.tangent = worldMatrix.TransformVector(vIn.tangent);
+				vOut.viewDirection = (worldMatrix.TransformPoint(vIn.position) - camera.GetOrigin());
+			}
+		});
+}
+
+
+void dae::SoftwareRasterizer::CullMeshlets(const MeshInstance* pInstance, const Camera& camera, std::vector<uint32_t>& visibleMeshlets, std::vector<uint8_t>& vertexMask) const
 {
+	const Mesh* pMesh{ pInstance->GetMesh() };
 
-	std::vector<Vertex_Out> verticesOut;
-	std::vector<Vertex> verticesIn = pMesh->GetVertices();
+	const std::vector<Meshlet>& meshlets{ pMesh->GetMeshlets() };
+	const std::vector<uint32_t>& meshletVertices{ pMesh->GetMeshletVertices() };
 
-	verticesOut.reserve(verticesIn.size());
+	visibleMeshlets.clear();
+	vertexMask.assign(pMesh->GetVertexCount(), 0);
 
-	Matrix worldMatrix = pMesh->GetWorldMatrix();
 
-	const Matrix worldViewProjectionMatrix{ worldMatrix * camera.GetViewMatrix() * camera.GetProjectionMatrix()};
+	//Frustum planes in object space, taken from the columns of the world view projection matrix
+	const Matrix worldViewProjectionMatrix{ pInstance->GetWorldMatrix() * camera.GetViewMatrix() * camera.GetProjectionMatrix() };
 
-	for (const auto& vIn : verticesIn)
+	Vector4 columns[4]{};
+
+	for (int column{}; column < 4; ++column)
+		columns[column] = Vector4{ worldViewProjectionMatrix[0][column], worldViewProjectionMatrix[1][column], worldViewProjectionMatrix[2][column], worldViewProjectionMatrix[3][column] };
+
+	const Vector4 planes[6]
 	{
-		
-		Vertex_Out vOut{ Vector4{}, vIn.uv , vIn.normal, vIn.tangent, {} };
-		
-		vOut.position = worldViewProjectionMatrix.TransformPoint({ vIn.position, 1.0f });
+		columns[3] + columns[0],
+		columns[3] - columns[0],
+		columns[3] + columns[1],
+		columns[3] - columns[1],
+		columns[2],
+		columns[3] - columns[2]
+	};
+
+	float planeLengths[6]{};
+
+	for (int planeIdx{}; planeIdx < 6; ++planeIdx)
+		planeLengths[planeIdx] = Vector3{ planes[planeIdx].x, planes[planeIdx].y, planes[planeIdx].z }.Magnitude();
+
+
+	const Vector3 cameraPosition{ Matrix::Inverse(pInstance->GetWorldMatrix()).TransformPoint(camera.GetOrigin()) };
+	const bool cullBackFacing{ pMesh->GetCullMode() == Mesh::CullMode::Back };
+
+	for (uint32_t meshletIdx{}; meshletIdx < meshlets.size(); ++meshletIdx)
+	{
+		const Meshlet& meshlet{ meshlets[meshletIdx] };
+
+		if (cullBackFacing && meshlet.IsBackFacing(cameraPosition))
+			continue;
 
-		const float invVInPosW{ 1.f / vOut.position.w };
+		bool isInside{ true };
 
-		vOut.position.x *= invVInPosW;
-		vOut.position.y *= invVInPosW;
-		vOut.position.z *= invVInPosW;
+		for (int planeIdx{}; planeIdx < 6 && isInside; ++planeIdx)
+		{
+			const Vector4& plane{ planes[planeIdx] };
+			const float distance{ plane.x * meshlet.center.x + plane.y * meshlet.center.y + plane.z * meshlet.center.z + plane.w };
+
+			isInside = distance >= -meshlet.radius * planeLengths[planeIdx];
+		}
+
+		if (!isInside)
+			continue;
 
-		vOut.normal = worldMatrix.TransformVector(vIn.normal);
-		vOut.tangent = worldMatrix.TransformVector(vIn.tangent);
-		vOut.viewDirection = (worldMatrix.TransformPoint(vIn.position) - camera.GetOrigin());
+		visibleMeshlets.emplace_back(meshletIdx);
 
-		verticesOut.emplace_back(vOut);
+		for (uint32_t i{}; i < meshlet.nrVertices; ++i)
+			vertexMask[meshletVertices[meshlet.firstVertex + i]] = 1;
 	}
+}
+
+void dae::SoftwareRasterizer::AllocateColorBuffer()
+{
+	delete[] m_pColorBufferPixels;
+
+	const int nrSamples{ m_PixelLayout.GetSampleBufferSize() };
 
-	pMesh->SetVerticesOut(verticesOut);
+	m_pColorBufferPixels = new ColorRGB[nrSamples];
+	std::fill_n(m_pColorBufferPixels, nrSamples, ColorRGB{ 0.f, 0.f, 0.f, 0.f });
+
+	delete[] m_pAccumulationPixels;
+	delete[] m_pRevealagePixels;
+
+	m_pAccumulationPixels = new ColorRGB[nrSamples];
+	m_pRevealagePixels = new float[nrSamples];
+
+	//Old contents are gone, every tile has to be cleared again
+	std::fill(m_TileCleared.begin(), m_TileCleared.end(), uint8_t{ 0 });
+	m_IsFullRedrawNeeded = true;
 }
 
+void dae::SoftwareRasterizer::UpdateDirtyTiles(const std::vector<MeshInstance*>& pInstances, const Camera& camera, bool isBackgroundUniform)
+{
+	const Matrix viewProjectionMatrix{ camera.GetViewMatrix() * camera.GetProjectionMatrix() };
+
+	const bool isFullRedraw{ m_IsFullRedrawNeeded || !m_IsDirtyTileRenderingEnabled
+		|| viewProjectionMatrix != m_DrawnViewProjectionMatrix || isBackgroundUniform != m_WasBackgroundUniform };
+
+	m_IsFullRedrawNeeded = false;
+	m_DrawnViewProjectionMatrix = viewProjectionMatrix;
+	m_WasBackgroundUniform = isBackgroundUniform;
+
+	std::fill(m_TileDirty.begin(), m_TileDirty.end(), static_cast<uint8_t>(isFullRedraw));
+
 
-void dae::SoftwareRasterizer::ResetDepthBufferAndClearBackground(bool isBackgroundUniform) const
+	std::unordered_map<const MeshInstance*, DrawnInstance> drawnInstances{};
+	drawnInstances.reserve(pInstances.size());
+
+	//Transparent meshes share one sort order between their instances, one change can reorder the triangles of all of them
+	std::vector<const Mesh*> pResortedMeshes{};
+
+	for (const MeshInstance* pInstance : pInstances)
+	{
+		if (!pInstance->IsActive())
+			continue;
+
+		DrawnInstance drawn{ pInstance->GetMesh(), pInstance->GetWorldMatrix(), pInstance->GetLodLevel() };
+		GetInstanceTileBounds(pInstance, viewProjectionMatrix, drawn.tileMin, drawn.tileMax);
+
+		const auto previousIt{ m_DrawnInstances.find(pInstance) };
+		const bool wasDrawn{ previousIt != m_DrawnInstances.end() };
+
+		if (!wasDrawn || previousIt->second.worldMatrix != drawn.worldMatrix || previousIt->second.lodLevel != drawn.lodLevel)
+		{
+			//Both where it is now and where it was last frame
+			MarkDirtyTiles(drawn.tileMin, drawn.tileMax);
+
+			if (wasDrawn)
+				MarkDirtyTiles(previousIt->second.tileMin, previousIt->second.tileMax);
+
+			if (drawn.pMesh->IsTransparent())
+				pResortedMeshes.emplace_back(drawn.pMesh);
+		}
+
+		if (wasDrawn)
+			m_DrawnInstances.erase(previousIt);
+
+		drawnInstances.emplace(pInstance, drawn);
+	}
+
+	//Drawn last frame but hidden, culled or disabled now
+	for (const auto& [pInstance, drawn] : m_DrawnInstances)
+	{
+		MarkDirtyTiles(drawn.tileMin, drawn.tileMax);
+
+		if (drawn.pMesh->IsTransparent())
+			pResortedMeshes.emplace_back(drawn.pMesh);
+	}
+
+	for (const auto& [pInstance, drawn] : drawnInstances)
+	{
+		if (std::find(pResortedMeshes.begin(), pResortedMeshes.end(), drawn.pMesh) != pResortedMeshes.end())
+			MarkDirtyTiles(drawn.tileMin, drawn.tileMax);
+	}
+
+	m_DrawnInstances = std::move(drawnInstances);
+}
+
+void dae::SoftwareRasterizer::GetInstanceTileBounds(const MeshInstance* pInstance, const Matrix& viewProjectionMatrix, Int2& tileMin, Int2& tileMax) const
 {
-	std::fill_n(m_pDepthBufferPixels, (m_Width * m_Height), FLT_MAX);
+	const Mesh* pMesh{ pInstance->GetMesh() };
+	const Vector3& boundsMin{ pMesh->GetBoundsMin() };
+	const Vector3& boundsMax{ pMesh->GetBoundsMax() };
 
+	const Matrix worldViewProjectionMatrix{ pInstance->GetWorldMatrix() * viewProjectionMatrix };
 
-	Uint8 color{};
+	Vector2 screenMin{ FLT_MAX, FLT_MAX };
+	Vector2 screenMax{ -FLT_MAX, -FLT_MAX };
 
-	if (isBackgroundUniform)
-		color = static_cast<Uint8>(0.1f * 255);
-	else
-		color = static_cast<Uint8>(0.39f * 255);
+	for (int cornerIdx{}; cornerIdx < 8; ++cornerIdx)
+	{
+		const Vector3 corner{ cornerIdx & 1 ? boundsMax.x : boundsMin.x, cornerIdx & 2 ? boundsMax.y : boundsMin.y, cornerIdx & 4 ? boundsMax.z : boundsMin.z };
+		const Vector4 projected{ worldViewProjectionMatrix.TransformPoint({ corner, 1.f }) };
+
+		//Bounds reaching behind the camera can end up anywhere on screen
+		if (projected.w <= FLT_EPSILON)
+		{
+			tileMin = { 0, 0 };
+			tileMax = { m_NrTilesX - 1, m_NrTilesY - 1 };
+			return;
+		}
+
+		const Vector2 screen{ (projected.x / projected.w + 1.f) / 2.f * m_Width, (1.f - projected.y / projected.w) / 2.f * m_Height };
+
+		screenMin = Vector2::Min(screenMin, screen);
+		screenMax = Vector2::Max(screenMax, screen);
+	}
+
+	//A pixel of margin for the samples around each pixel coordinate
+	const int minX{ static_cast<int>(std::floor(std::clamp(screenMin.x - 1.f, -1.f, static_cast<float>(m_Width)))) };
+	const int minY{ static_cast<int>(std::floor(std::clamp(screenMin.y - 1.f, -1.f, static_cast<float>(m_Height)))) };
+	const int maxX{ static_cast<int>(std::ceil(std::clamp(screenMax.x + 1.f, -1.f, static_cast<float>(m_Width)))) };
+	const int maxY{ static_cast<int>(std::ceil(std::clamp(screenMax.y + 1.f, -1.f, static_cast<float>(m_Height)))) };
+
+	if (maxX < 0 || maxY < 0 || minX >= m_Width || minY >= m_Height)
+	{
+		tileMin = { 0, 0 };
+		tileMax = { -1, -1 };
+		return;
+	}
+
+	tileMin = { std::max(minX, 0) / m_TileSize, std::max(minY, 0) / m_TileSize };
+	tileMax = { std::min(maxX, m_Width - 1) / m_TileSize, std::min(maxY, m_Height - 1) / m_TileSize };
+}
 
-	SDL_FillRect(m_pBackBuffer, nullptr, SDL_MapRGB(m_pBackBuffer->format, color, color, color));
+void dae::SoftwareRasterizer::MarkDirtyTiles(const Int2& tileMin, const Int2& tileMax)
+{
+	for (int tileY{ tileMin.y }; tileY <= tileMax.y; ++tileY)
+	{
+		for (int tileX{ tileMin.x }; tileX <= tileMax.x; ++tileX)
+			m_TileDirty[tileX + tileY * m_NrTilesX] = 1;
+	}
+}
+
+bool dae::SoftwareRasterizer::HasDirtyTile(const Int2& tileMin, const Int2& tileMax) const
+{
+	for (int tileY{ tileMin.y }; tileY <= tileMax.y; ++tileY)
+	{
+		for (int tileX{ tileMin.x }; tileX <= tileMax.x; ++tileX)
+		{
+			if (m_TileDirty[tileX + tileY * m_NrTilesX])
+				return true;
+		}
+	}
 
+	return false;
+}
 
+void dae::SoftwareRasterizer::ResetTiles()
+{
+	// Tiles are cleared lazily by the first job that rasterizes into them
+	for (size_t tileIdx{}; tileIdx < m_TileCleared.size(); ++tileIdx)
+	{
+		if (m_TileDirty[tileIdx])
+			m_TileCleared[tileIdx] = 0;
+	}
+}
+
+void dae::SoftwareRasterizer::ClearTile(int tileIdx)
+{
+	Int2 tileMin{}, tileMax{};
+	GetTileBounds(tileIdx, tileMin, tileMax);
+
+	//Samples of a pixel are stored next to each other, so ranges of pixels stay ranges of samples
+	const int sampleCount{ m_PixelLayout.sampleCount };
+
+	const auto clearRange = [&](int startIdx, int count)
+		{
+			std::fill_n(m_pColorBufferPixels + startIdx, count, ColorRGB{ 0.f, 0.f, 0.f, 0.f });
+
+			if (m_IsOITEnabled)
+			{
+				std::fill_n(m_pAccumulationPixels + startIdx, count, ColorRGB{ 0.f, 0.f, 0.f, 0.f });
+				std::fill_n(m_pRevealagePixels + startIdx, count, 1.f);
+			}
+		};
+
+	if (m_PixelLayout.IsTileContiguous())
+		clearRange(m_PixelLayout.GetTileStart(tileIdx) * sampleCount, m_TileSize * m_TileSize * sampleCount);
+	else
+	{
+		for (int py{ tileMin.y }; py < tileMax.y; ++py)
+			clearRange((tileMin.x + py * m_Width) * sampleCount, (tileMax.x - tileMin.x) * sampleCount);
+	}
+
+	m_pDepthBuffer->ResetTile(tileIdx);
+	m_TileCleared[tileIdx] = 1;
+}
+
+void dae::SoftwareRasterizer::GetTileBounds(int tileIdx, Int2& tileMin, Int2& tileMax) const
+{
+	tileMin.x = (tileIdx % m_NrTilesX) * m_TileSize;
+	tileMin.y = (tileIdx / m_NrTilesX) * m_TileSize;
+	tileMax.x = std::min(tileMin.x + m_TileSize, m_Width);
+	tileMax.y = std::min(tileMin.y + m_TileSize, m_Height);
 }
 
 
@@ -146,66 +557,237 @@ bool dae::SoftwareRasterizer::IsVertexInFrustrum(const Vector4& vertex, float mi
 }
 
 
-void dae::SoftwareRasterizer::Render(Mesh* pMesh, Camera& camera) const
+void dae::SoftwareRasterizer::Render(MeshInstance* const* ppInstances, size_t nrInstances, Camera& camera, RasterPass pass)
 {
+	const Mesh* pMesh{ ppInstances[0]->GetMesh() };
+
+	//Transparent meshes write no depth, so they have nothing to show in the depth visualization
+	if (m_RenderMode == RenderMode::Depth && pMesh->IsTransparent() && !m_IsShowingBoundingBoxes)
+		return;
+
+	if (m_VisibleMeshlets.size() < nrInstances)
+	{
+		m_VisibleMeshlets.resize(nrInstances);
+		m_VertexMasks.resize(nrInstances);
+	}
+
+	m_UsesMeshlets.assign(nrInstances, 0);
+
+
+	//Whole clusters that are off screen or back facing are dropped before any vertex is transformed
+	//Sorted transparent meshes and coarser LODs no longer follow the order the meshlets were built from
+	for (size_t instanceIdx{}; instanceIdx < nrInstances; ++instanceIdx)
+	{
+		const MeshInstance* pInstance{ ppInstances[instanceIdx] };
+
+		if (!pInstance->IsActive())
+			continue;
+
+		m_UsesMeshlets[instanceIdx] = m_IsMeshletCullingEnabled && !pMesh->GetMeshlets().empty() && &pInstance->GetDrawIndices() == &pMesh->GetIndices();
+
+		if (m_UsesMeshlets[instanceIdx])
+			CullMeshlets(pInstance, camera, m_VisibleMeshlets[instanceIdx], m_VertexMasks[instanceIdx]);
+	}
+
 
 	//World Space -> NDC
-	VertexTransformationFunction(pMesh, camera);
+	VertexTransformationFunction(ppInstances, nrInstances, camera);
 
 
-	//NDC -> Screen Space
-	std::vector<Vector2> verticesScreen;
-	verticesScreen.reserve(pMesh->GetVerticesOut().size());
+	//Instances share the depth and color buffers, so they are rasterized in order
+	//Instances away from every dirty tile are still on screen from last frame
+	for (size_t instanceIdx{}; instanceIdx < nrInstances; ++instanceIdx)
+	{
+		if (!ppInstances[instanceIdx]->IsActive())
+			continue;
+
+		const DrawnInstance& drawn{ m_DrawnInstances.at(ppInstances[instanceIdx]) };
+
+		if (HasDirtyTile(drawn.tileMin, drawn.tileMax))
+			RenderInstance(ppInstances[instanceIdx], camera, m_UsesMeshlets[instanceIdx] ? &m_VisibleMeshlets[instanceIdx] : nullptr, pass);
+	}
+}
+
+
+void dae::SoftwareRasterizer::RenderInstance(MeshInstance* pInstance, const Camera& camera, const std::vector<uint32_t>* pVisibleMeshlets, RasterPass pass)
+{
+	const Mesh* pMesh{ pInstance->GetMesh() };
+
+	MeshInstance::TransformCache& cache{ pInstance->GetTransformCache() };
 
-	for (const Vertex_Out& vertexNdc : pMesh->GetVerticesOut())
+	//NDC -> Screen Space, only redone for new positions or a new viewport
+	if (!cache.arePositionsScreenValid || cache.screenWidth != m_Width || cache.screenHeight != m_Height)
 	{
-		verticesScreen.emplace_back(Vector2{ (vertexNdc.position.x + 1.f) / 2.f * m_Width, (1.f - vertexNdc.position.y) / 2.f * m_Height });
-	};
+		std::vector<Vector2>& positionsScreen{ pInstance->GetPositionsScreen() };
+		positionsScreen.clear();
+		positionsScreen.reserve(pInstance->GetPositionsOut().size());
+
+		for (const Vector4& positionNdc : pInstance->GetPositionsOut())
+		{
+			positionsScreen.emplace_back(Vector2{ (positionNdc.x + 1.f) / 2.f * m_Width, (1.f - positionNdc.y) / 2.f * m_Height });
+		};
+
+		cache.screenWidth = m_Width;
+		cache.screenHeight = m_Height;
+		cache.arePositionsScreenValid = true;
+	}
+
+	const std::vector<Vector2>& verticesScreen{ pInstance->GetPositionsScreen() };
+
+
+	BinMeshTriangles(pInstance, verticesScreen, pVisibleMeshlets);
 
 
-	switch (pMesh->GetPrimitiveTopology())
+	//The depth visualization is built from the depth buffer afterwards, so no shading at all
+	const bool isDepthOnly{ pass == RasterPass::Depth || (m_RenderMode == RenderMode::Depth && !m_IsShowingBoundingBoxes) };
+	const bool isDepthPrepassed{ pass == RasterPass::Shade };
+
+	//Depth and bounding boxes only need positions, otherwise just the vertices of binned triangles get attributes
+	//The transform cache key covers everything binning depends on, so unchanged positions bin the same triangles as when the attributes were made
+	if (!isDepthOnly && m_RenderMode == RenderMode::Default && !m_IsShowingBoundingBoxes && !cache.areAttributesValid)
 	{
-	case Mesh::PrimitiveTopology::TriangleStrip:
+		ComputeVertexAttributes(pInstance, camera);
+		cache.areAttributesValid = true;
+	}
 
-		for (size_t vertIdx{}; vertIdx < pMesh->GetIndices().size() - 2; ++vertIdx)
+
+	//Every tile is owned by one job, so depth tests and blending never race and keep the draw order
+	concurrency::parallel_for(0, static_cast<int>(m_TileBins.size()),
+		[&](int tileIdx)
 		{
-			RenderMeshTriangle(pMesh, verticesScreen, vertIdx, vertIdx & 1);
-		}
+			const std::vector<uint32_t>& tileBin{ m_TileBins[tileIdx] };
 
-		break;
+			if (tileBin.empty())
+				return;
+
+			if (!m_TileCleared[tileIdx])
+				ClearTile(tileIdx);
 
-	case Mesh::PrimitiveTopology::TriangleList:
+			Int2 tileMin{}, tileMax{};
+			GetTileBounds(tileIdx, tileMin, tileMax);
 
-		concurrency::parallel_for(0u, pMesh->GetNumIndices() / 3,
-			[&](size_t i)
+			const bool isStrip{ pMesh->GetPrimitiveTopology() == Mesh::PrimitiveTopology::TriangleStrip };
+
+			if (isDepthOnly)
 			{
-				RenderMeshTriangle(pMesh, verticesScreen, i * 3, false);
-			});
-	
-		break;
-	}
+				for (const uint32_t triangleIdx : tileBin)
+				{
+					if (isStrip)
+						RenderMeshTriangleDepth(pInstance, verticesScreen, triangleIdx, triangleIdx & 1, tileIdx, tileMin, tileMax);
+					else
+						RenderMeshTriangleDepth(pInstance, verticesScreen, triangleIdx * 3, false, tileIdx, tileMin, tileMax);
+				}
+
+				return;
+			}
+
+			for (const uint32_t triangleIdx : tileBin)
+			{
+				if (isStrip)
+					RenderMeshTriangle(pInstance, verticesScreen, triangleIdx, triangleIdx & 1, tileIdx, tileMin, tileMax, isDepthPrepassed);
+				else
+					RenderMeshTriangle(pInstance, verticesScreen, triangleIdx * 3, false, tileIdx, tileMin, tileMax, isDepthPrepassed);
+			}
+		});
 
 }
 
 
-void dae::SoftwareRasterizer::RenderMeshTriangle(const Mesh* pMesh, const std::vector<Vector2>& verticesScreen, size_t currentVertexIdx, bool swapVertices) const
+void dae::SoftwareRasterizer::BinMeshTriangles(const MeshInstance* pInstance, const std::vector<Vector2>& verticesScreen, const std::vector<uint32_t>* pVisibleMeshlets)
 {
-	const Vector2 screenVector{ static_cast<float>(m_Width), static_cast<float>(m_Height) };
+	for (std::vector<uint32_t>& tileBin : m_TileBins)
+		tileBin.clear();
 
 
-	const size_t vertIdx0{ pMesh->GetIndices()[currentVertexIdx + (2 * swapVertices)] };
-	const size_t vertIdx1{ pMesh->GetIndices()[currentVertexIdx + 1] };
-	const size_t vertIdx2{ pMesh->GetIndices()[currentVertexIdx + (!swapVertices * 2)] };
+	const Mesh* pMesh{ pInstance->GetMesh() };
 
+	const std::vector<uint32_t>& indices{ pInstance->GetDrawIndices() };
+	const std::vector<Vector4>& positionsOut{ pInstance->GetPositionsOut() };
 
-	if (vertIdx0 == vertIdx1 || vertIdx1 == vertIdx2 || vertIdx2 == vertIdx0)
-		return;
+	m_ReferencedVertices.assign(positionsOut.size(), 0);
+
+	const bool isStrip{ pMesh->GetPrimitiveTopology() == Mesh::PrimitiveTopology::TriangleStrip };
+	const size_t nrTriangles{ isStrip ? (indices.size() >= 2 ? indices.size() - 2 : 0) : indices.size() / 3 };
+
+
+	const auto binTriangle = [&](size_t triangleIdx)
+		{
+			const size_t currentVertexIdx{ isStrip ? triangleIdx : triangleIdx * 3 };
+			const bool swapVertices{ isStrip && (triangleIdx & 1) };
+
+			const size_t vertIdx0{ indices[currentVertexIdx + (2 * swapVertices)] };
+			const size_t vertIdx1{ indices[currentVertexIdx + 1] };
+			const size_t vertIdx2{ indices[currentVertexIdx + (!swapVertices * 2)] };
 
 
-	if (!IsVertexInFrustrum(pMesh->GetVerticesOut()[vertIdx0].position)
-		|| !IsVertexInFrustrum(pMesh->GetVerticesOut()[vertIdx1].position)
-		|| !IsVertexInFrustrum(pMesh->GetVerticesOut()[vertIdx2].position))
+			if (vertIdx0 == vertIdx1 || vertIdx1 == vertIdx2 || vertIdx2 == vertIdx0)
+				return;
+
+
+			if (!IsVertexInFrustrum(positionsOut[vertIdx0])
+				|| !IsVertexInFrustrum(positionsOut[vertIdx1])
+				|| !IsVertexInFrustrum(positionsOut[vertIdx2]))
+				return;
+
+			m_ReferencedVertices[vertIdx0] = 1;
+			m_ReferencedVertices[vertIdx1] = 1;
+			m_ReferencedVertices[vertIdx2] = 1;
+
+
+			const Vector2& v0{ verticesScreen[vertIdx0] };
+			const Vector2& v1{ verticesScreen[vertIdx1] };
+			const Vector2& v2{ verticesScreen[vertIdx2] };
+
+			const Vector2 minBoundingBox{ Vector2::Min(v0, Vector2::Min(v1, v2)) };
+			const Vector2 maxBoundingBox{ Vector2::Max(v0, Vector2::Max(v1, v2)) };
+
+			const int minTileX{ Clamp(static_cast<int>(minBoundingBox.x) / m_TileSize, 0, m_NrTilesX - 1) };
+			const int minTileY{ Clamp(static_cast<int>(minBoundingBox.y) / m_TileSize, 0, m_NrTilesY - 1) };
+			const int maxTileX{ Clamp(static_cast<int>(std::ceil(maxBoundingBox.x)) / m_TileSize, 0, m_NrTilesX - 1) };
+			const int maxTileY{ Clamp(static_cast<int>(std::ceil(maxBoundingBox.y)) / m_TileSize, 0, m_NrTilesY - 1) };
+
+
+			for (int tileY{ minTileY }; tileY <= maxTileY; ++tileY)
+			{
+				for (int tileX{ minTileX }; tileX <= maxTileX; ++tileX)
+				{
+					if (m_TileDirty[tileX + tileY * m_NrTilesX])
+						m_TileBins[tileX + tileY * m_NrTilesX].emplace_back(static_cast<uint32_t>(triangleIdx));
+				}
+			}
+		};
+
+
+	//Only the triangles of clusters that survived CullMeshlets, in index order
+	if (pVisibleMeshlets)
+	{
+		for (const uint32_t meshletIdx : *pVisibleMeshlets)
+		{
+			const Meshlet& meshlet{ pMesh->GetMeshlets()[meshletIdx] };
+
+			for (uint32_t triangleIdx{ meshlet.firstTriangle }; triangleIdx < meshlet.firstTriangle + meshlet.nrTriangles; ++triangleIdx)
+				binTriangle(triangleIdx);
+		}
+
 		return;
+	}
+
+	for (size_t triangleIdx{}; triangleIdx < nrTriangles; ++triangleIdx)
+		binTriangle(triangleIdx);
+}
+
+
+void dae::SoftwareRasterizer::RenderMeshTriangle(const MeshInstance* pInstance, const std::vector<Vector2>& verticesScreen, size_t currentVertexIdx, bool swapVertices, int tileIdx, const Int2& tileMin, const Int2& tileMax, bool isDepthPrepassed) const
+{
+	const Mesh* pMesh{ pInstance->GetMesh() };
+	const std::vector<uint32_t>& indices{ pInstance->GetDrawIndices() };
+	const std::vector<Vector4>& positionsOut{ pInstance->GetPositionsOut() };
+	const std::vector<VertexAttributes_Out>& attributesOut{ pInstance->GetAttributesOut() };
+
+	//Degenerate and out of frustum triangles are already rejected in BinMeshTriangles
+	const size_t vertIdx0{ indices[currentVertexIdx + (2 * swapVertices)] };
+	const size_t vertIdx1{ indices[currentVertexIdx + 1] };
+	const size_t vertIdx2{ indices[currentVertexIdx + (!swapVertices * 2)] };
 
 
 
@@ -225,32 +807,101 @@ void dae::SoftwareRasterizer::RenderMeshTriangle(const Mesh* pMesh, const std::v
 	const float invTriangleArea{ 1.f / Vector2::Cross( edgeV0V1, edgeV2V0) };
 
 
-	//Bounding Box - Optimization
-	Vector2 minBoundingBox{ Vector2::Min(v0, Vector2::Min(v1, v2)) };
-	Vector2 maxBoundingBox{ Vector2::Max(v0, Vector2::Max(v1, v2)) };
+	const int sampleCount{ m_PixelLayout.sampleCount };
+	const float sampleExtent{ PixelLayout::GetSampleExtent(sampleCount) };
+	const uint32_t allSamplesMask{ (1u << sampleCount) - 1u };
+
+
+	//Bounding Box - Optimization, grown so samples around a pixel coordinate are not missed
+	const Vector2 sampleExtentVector{ sampleExtent, sampleExtent };
+	Vector2 minBoundingBox{ Vector2::Min(v0, Vector2::Min(v1, v2)) - sampleExtentVector };
+	Vector2 maxBoundingBox{ Vector2::Max(v0, Vector2::Max(v1, v2)) + sampleExtentVector };
+
+	//Clip to the tile this job owns
+	const Vector2 tileMinVector{ static_cast<float>(tileMin.x), static_cast<float>(tileMin.y) };
+	const Vector2 tileMaxVector{ static_cast<float>(tileMax.x), static_cast<float>(tileMax.y) };
+
+	minBoundingBox = Vector2::Max(tileMinVector, Vector2::Min(minBoundingBox, tileMaxVector));
+	maxBoundingBox = Vector2::Max(tileMinVector, Vector2::Min(maxBoundingBox, tileMaxVector));
 
-	minBoundingBox = Vector2::Max(Vector2::Zero, Vector2::Min(minBoundingBox, screenVector));
-	maxBoundingBox = Vector2::Max(Vector2::Zero, Vector2::Min(maxBoundingBox, screenVector));
 
+	//NDC depth is affine in screen space, so it interpolates linearly and forms a plane per triangle
+	const float depth0{ positionsOut[vertIdx0].z };
+	const float depth1{ positionsOut[vertIdx1].z };
+	const float depth2{ positionsOut[vertIdx2].z };
 
-	for (int px{ static_cast<int>(minBoundingBox.x) }; px < maxBoundingBox.x; ++px)
+	const float w0{ positionsOut[vertIdx0].w };
+	const float w1{ positionsOut[vertIdx1].w };
+	const float w2{ positionsOut[vertIdx2].w };
+
+	const auto interpolateDepth = [&](const Vector2& pixel)
+		{
+			return Vector2::Cross(pixel - v1, edgeV1V2) * invTriangleArea * depth0
+				+ Vector2::Cross(pixel - v2, edgeV2V0) * invTriangleArea * depth1
+				+ Vector2::Cross(pixel - v0, edgeV0V1) * invTriangleArea * depth2;
+		};
+
+	const auto isInsideTriangle = [&](float px, float py)
+		{
+			const Vector2 pixel{ px, py };
+			return CheckCullMode(pMesh, Vector2::Cross(pixel - v0, edgeV0V1), Vector2::Cross(pixel - v1, edgeV1V2), Vector2::Cross(pixel - v2, edgeV2V0));
+		};
+
+
+	//Edge functions are affine, so moving to a sample only adds a constant per triangle
+	float sampleEdgeOffsets[PixelLayout::MaxSampleCount][3]{};
+
+	for (int sample{}; sample < sampleCount; ++sample)
+	{
+		const Vector2 sampleOffset{ PixelLayout::GetSampleOffset(sampleCount, sample) };
+
+		sampleEdgeOffsets[sample][0] = Vector2::Cross(sampleOffset, edgeV0V1);
+		sampleEdgeOffsets[sample][1] = Vector2::Cross(sampleOffset, edgeV1V2);
+		sampleEdgeOffsets[sample][2] = Vector2::Cross(sampleOffset, edgeV2V0);
+	}
+
+
+	//An opaque triangle covering the whole tile can replace its depth with one plane and skip all depth tests
+	bool skipDepthTest{ false };
+
+	if (!pMesh->IsTransparent() && !m_IsShowingBoundingBoxes && !isDepthPrepassed)
+	{
+		const float tileLeft{ static_cast<float>(tileMin.x) - sampleExtent };
+		const float tileTop{ static_cast<float>(tileMin.y) - sampleExtent };
+		const float tileRight{ static_cast<float>(tileMax.x - 1) + sampleExtent };
+		const float tileBottom{ static_cast<float>(tileMax.y - 1) + sampleExtent };
+
+		if (isInsideTriangle(tileLeft, tileTop) && isInsideTriangle(tileRight, tileTop)
+			&& isInsideTriangle(tileLeft, tileBottom) && isInsideTriangle(tileRight, tileBottom))
+		{
+			DepthBuffer::Plane plane{};
+			plane.c = interpolateDepth(Vector2::Zero);
+			plane.a = interpolateDepth(Vector2::UnitX) - plane.c;
+			plane.b = interpolateDepth(Vector2::UnitY) - plane.c;
+
+			skipDepthTest = m_pDepthBuffer->TryCompressTile(tileIdx, plane);
+		}
+	}
+
+	if (!skipDepthTest)
+		m_pDepthBuffer->DecompressTile(tileIdx);
+
+
+	//Row by row, so consecutive pixels are adjacent in the color and depth buffers
+	for (int py{ static_cast<int>(minBoundingBox.y) }; py < maxBoundingBox.y; ++py)
 	{
-		for (int py{ static_cast<int>(minBoundingBox.y) }; py < maxBoundingBox.y; ++py)
+		for (int px{ static_cast<int>(minBoundingBox.x) }; px < maxBoundingBox.x; ++px)
 		{
 
-			const int pixelIdx{ px + py * m_Width };
+			const int pixelIdx{ m_PixelLayout.ToIndex(px, py) };
 
 			const Vector2 currentPixel{ static_cast<float>(px),static_cast<float>(py) };
 
-			Vector2 pixelPos = { static_cast<float>(pixelIdx % static_cast<int>(m_Width)), static_cast<float>(pixelIdx / static_cast<int>(m_Height)) };
-
 
 			if (m_IsShowingBoundingBoxes)
 			{
-				m_pBackBufferPixels[pixelIdx] = SDL_MapRGB(m_pBackBuffer->format,
-					static_cast<uint8_t>(255),
-					static_cast<uint8_t>(255),
-					static_cast<uint8_t>(255));
+				ColorRGB white{ 1.f, 1.f, 1.f, 1.f };
+				UpdateColorInBuffer(pixelIdx, allSamplesMask, white);
 				continue;
 			}
 
@@ -260,34 +911,44 @@ void dae::SoftwareRasterizer::RenderMeshTriangle(const Mesh* pMesh, const std::v
 			const float edge2{ Vector2::Cross(currentPixel - v2, edgeV2V0) };
 
 
+			//Coverage and depth are per sample, everything below runs once per pixel
+			uint32_t coverageMask{};
 
-			if (!CheckCullMode(pMesh, edge0, edge1, edge2)) continue;
-
+			for (int sample{}; sample < sampleCount; ++sample)
+			{
+				const float sampleEdge0{ edge0 + sampleEdgeOffsets[sample][0] };
+				const float sampleEdge1{ edge1 + sampleEdgeOffsets[sample][1] };
+				const float sampleEdge2{ edge2 + sampleEdgeOffsets[sample][2] };
 
-			//Weight 
-			float weight0, weight1, weight2;
-			weight0 = edge1 * invTriangleArea;
-			weight1 = edge2 * invTriangleArea;
-			weight2 = edge0 * invTriangleArea;
+				if (!CheckCullMode(pMesh, sampleEdge0, sampleEdge1, sampleEdge2)) continue;
 
 
+				const float sampleDepth{ (sampleEdge1 * depth0 + sampleEdge2 * depth1 + sampleEdge0 * depth2) * invTriangleArea };
 
-			const float depth0{ pMesh->GetVerticesOut()[vertIdx0].position.z };
-			const float depth1{ pMesh->GetVerticesOut()[vertIdx1].position.z };
-			const float depth2{ pMesh->GetVerticesOut()[vertIdx2].position.z };
+				if (sampleDepth < 0.f || sampleDepth > 1.f) continue;
 
-			const float interpolatedDepth{ 1.f / (weight0 * (1.f / depth0) + weight1 * (1.f / depth1) + weight2 * (1.f / depth2)) };
 
+				const int sampleIdx{ m_PixelLayout.ToSampleIndex(pixelIdx, sample) };
 
+				//After a prepass the buffer already holds the final depth, only the surface matching it passes
+				if (isDepthPrepassed)
+				{
+					if (!m_pDepthBuffer->TestVisible(sampleIdx, sampleDepth)) continue;
+				}
+				else if (!skipDepthTest && !m_pDepthBuffer->TestAndWrite(sampleIdx, sampleDepth, !pMesh->IsTransparent())) continue;
 
-			if (m_pDepthBufferPixels[pixelIdx] <= interpolatedDepth || interpolatedDepth < 0.f || interpolatedDepth > 1.f) continue;
+				coverageMask |= 1u << sample;
+			}
 
+			if (coverageMask == 0) continue;
 
-			if (!pMesh->IsTransparent())
-				m_pDepthBufferPixels[pixelIdx] = interpolatedDepth;
 
+			//Weight, at the pixel coordinate even when only some of its samples are covered
+			float weight0, weight1, weight2;
+			weight0 = edge1 * invTriangleArea;
+			weight1 = edge2 * invTriangleArea;
+			weight2 = edge0 * invTriangleArea;
 
-			ColorRGB finalColor{};
 
 
 			switch (m_RenderMode)
@@ -297,56 +958,64 @@ void dae::SoftwareRasterizer::RenderMeshTriangle(const Mesh* pMesh, const std::v
 
 					Vertex_Out pixel{};
 
-					const Vertex_Out& v0Out{ pMesh->GetVerticesOut()[vertIdx0] };
-					const Vertex_Out& v1Out{ pMesh->GetVerticesOut()[vertIdx1] };
-					const Vertex_Out& v2Out{ pMesh->GetVerticesOut()[vertIdx2] };
+					const VertexAttributes_Out& v0Out{ attributesOut[vertIdx0] };
+					const VertexAttributes_Out& v1Out{ attributesOut[vertIdx1] };
+					const VertexAttributes_Out& v2Out{ attributesOut[vertIdx2] };
 
 
 					const float interpolatedWDepth { 
-						1.f / (weight0 * (1.f / v0Out.position.w) +
-						weight1 * (1.f / v1Out.position.w) +
-						weight2 * (1.f / v2Out.position.w )) };
+						1.f / (weight0 * (1.f / w0) +
+						weight1 * (1.f / w1) +
+						weight2 * (1.f / w2 )) };
 
 
-					pixel.position = { static_cast<float>(px), static_cast<float>(py), 0.f, 0.f };
+					pixel.position = { static_cast<float>(px), static_cast<float>(py), 0.f, interpolatedWDepth };
 
 					pixel.uv = interpolatedWDepth *
-						((weight0 * v0Out.uv) / v0Out.position.w +
-							(weight1 * v1Out.uv) / v1Out.position.w +
-							(weight2 * v2Out.uv) / v2Out.position.w );
+						((weight0 * v0Out.uv) / w0 +
+							(weight1 * v1Out.uv) / w1 +
+							(weight2 * v2Out.uv) / w2 );
+
+
+					//Alpha test first, transparent meshes only need the uv and most of their pixels are discarded
+					if (pMesh->IsTransparent())
+					{
+						const Texture* pDiffuseMap{ pMesh->GetDiffuseMap() };
+
+						if (pDiffuseMap->IsFullyTransparent(pixel.uv)) continue;
+
+						ColorRGB diffuseColor{ pDiffuseMap->Sample(pixel.uv) };
+
+						if (diffuseColor.a < FLT_EPSILON) continue;
+
+						TransparentShading(pixelIdx, coverageMask, diffuseColor, interpolatedWDepth);
+						continue;
+					}
 
 
 					pixel.normal = Vector3{ interpolatedWDepth *
-						(weight0 * v0Out.normal / v0Out.position.w +
-						weight1 * v1Out.normal / v1Out.position.w +
-						weight2 * v2Out.normal / v2Out.position.w) }.Normalized();
+						(weight0 * v0Out.normal / w0 +
+						weight1 * v1Out.normal / w1 +
+						weight2 * v2Out.normal / w2) }.Normalized();
 
 
 					pixel.tangent = Vector3{ interpolatedWDepth *
-						(weight0 * v0Out.tangent / v0Out.position.w +
-						weight1 * v1Out.tangent / v1Out.position.w +
-						weight2 * v2Out.tangent / v2Out.position.w) }.Normalized();
+						(weight0 * v0Out.tangent / w0 +
+						weight1 * v1Out.tangent / w1 +
+						weight2 * v2Out.tangent / w2) }.Normalized();
 
 					pixel.viewDirection = Vector3{ interpolatedWDepth *
-						(weight0 * v0Out.viewDirection / v0Out.position.w +
-						weight1 * v1Out.viewDirection / v1Out.position.w +
-						weight2 * v2Out.viewDirection / v2Out.position.w) }.Normalized();
+						(weight0 * v0Out.viewDirection / w0 +
+						weight1 * v1Out.viewDirection / w1 +
+						weight2 * v2Out.viewDirection / w2) }.Normalized();
 
-					PixelShading(pixel, pMesh, pixelIdx);
+					PixelShading(pixel, pMesh, pixelIdx, coverageMask);
 					continue;
 				}
 				case RenderMode::Depth:
 				{
-
-					if (pMesh->IsTransparent()) continue;
-
-
-					const float depthCol{ Remap(interpolatedDepth , 0.985f,1.f) };
-					finalColor = { depthCol,depthCol,depthCol };
-
-					UpdateColorInBuffer(px, py, finalColor);
+					//Only reached for bounding boxes, depth is rasterized by RenderMeshTriangleDepth
 					continue;
-
 				}
 
 
@@ -358,48 +1027,215 @@ void dae::SoftwareRasterizer::RenderMeshTriangle(const Mesh* pMesh, const std::v
 }
 
 
-void dae::SoftwareRasterizer::PixelShading(const Vertex_Out& pixel, const Mesh* pMesh, int pixelIdx) const
+void dae::SoftwareRasterizer::RenderMeshTriangleDepth(const MeshInstance* pInstance, const std::vector<Vector2>& verticesScreen, size_t currentVertexIdx, bool swapVertices, int tileIdx, const Int2& tileMin, const Int2& tileMax) const
 {
-	//Color
-	ColorRGB finalColor{};
+	const Mesh* pMesh{ pInstance->GetMesh() };
+	const std::vector<uint32_t>& indices{ pInstance->GetDrawIndices() };
+	const std::vector<Vector4>& positionsOut{ pInstance->GetPositionsOut() };
 
+	const size_t vertIdx0{ indices[currentVertexIdx + (2 * swapVertices)] };
+	const size_t vertIdx1{ indices[currentVertexIdx + 1] };
+	const size_t vertIdx2{ indices[currentVertexIdx + (!swapVertices * 2)] };
 
-	const float lightIntensity{ 7.f };
-	const float kd{ 1.f };
-	const float shininess{ 25.f };
-	Vector3 sampledNormal{ pixel.normal };
-	const ColorRGB ambient{ 0.025f, 0.025f, 0.025f };
+	const Vector2& v0{ verticesScreen[vertIdx0] };
+	const Vector2& v1{ verticesScreen[vertIdx1] };
+	const Vector2& v2{ verticesScreen[vertIdx2] };
 
+	const Vector2 edgeV0V1{ v1 - v0 };
+	const Vector2 edgeV1V2{ v2 - v1 };
+	const Vector2 edgeV2V0{ v0 - v2 };
+
+	const float invTriangleArea{ 1.f / Vector2::Cross(edgeV0V1, edgeV2V0) };
+
+	const float depth0{ positionsOut[vertIdx0].z };
+	const float depth1{ positionsOut[vertIdx1].z };
+	const float depth2{ positionsOut[vertIdx2].z };
 
-	if (pMesh->IsTransparent())
-	{
 
-		const ColorRGB diffuseColor{ pMesh->GetDiffuseMap()->Sample(pixel.uv) };
+	const int sampleCount{ m_PixelLayout.sampleCount };
+	const float sampleExtent{ PixelLayout::GetSampleExtent(sampleCount) };
 
+	const Vector2 sampleExtentVector{ sampleExtent, sampleExtent };
+	const Vector2 tileMinVector{ static_cast<float>(tileMin.x), static_cast<float>(tileMin.y) };
+	const Vector2 tileMaxVector{ static_cast<float>(tileMax.x), static_cast<float>(tileMax.y) };
 
-		if (diffuseColor.a < FLT_EPSILON)
+	const Vector2 minBoundingBox{ Vector2::Max(tileMinVector, Vector2::Min(Vector2::Min(v0, Vector2::Min(v1, v2)) - sampleExtentVector, tileMaxVector)) };
+	const Vector2 maxBoundingBox{ Vector2::Max(tileMinVector, Vector2::Min(Vector2::Max(v0, Vector2::Max(v1, v2)) + sampleExtentVector, tileMaxVector)) };
+
+
+	const auto interpolateDepth = [&](const Vector2& pixel)
 		{
-			return;
-		}
-		else
+			return Vector2::Cross(pixel - v1, edgeV1V2) * invTriangleArea * depth0
+				+ Vector2::Cross(pixel - v2, edgeV2V0) * invTriangleArea * depth1
+				+ Vector2::Cross(pixel - v0, edgeV0V1) * invTriangleArea * depth2;
+		};
+
+	const auto isInsideTriangle = [&](float px, float py)
 		{
-			Uint8 r{}, g{}, b{};
-			SDL_GetRGB(m_pBackBufferPixels[pixelIdx], m_pBackBuffer->format, &r, &g, &b);
+			const Vector2 pixel{ px, py };
+			return CheckCullMode(pMesh, Vector2::Cross(pixel - v0, edgeV0V1), Vector2::Cross(pixel - v1, edgeV1V2), Vector2::Cross(pixel - v2, edgeV2V0));
+		};
 
-			constexpr float maxColorValue{ 255.0f };
-			const ColorRGB prevColor{ r / maxColorValue, g / maxColorValue, b / maxColorValue };
 
+	//A triangle covering the whole tile in front of everything is done after writing one plane
+	{
+		const float tileLeft{ static_cast<float>(tileMin.x) - sampleExtent };
+		const float tileTop{ static_cast<float>(tileMin.y) - sampleExtent };
+		const float tileRight{ static_cast<float>(tileMax.x - 1) + sampleExtent };
+		const float tileBottom{ static_cast<float>(tileMax.y - 1) + sampleExtent };
+
+		if (isInsideTriangle(tileLeft, tileTop) && isInsideTriangle(tileRight, tileTop)
+			&& isInsideTriangle(tileLeft, tileBottom) && isInsideTriangle(tileRight, tileBottom))
+		{
+			DepthBuffer::Plane plane{};
+			plane.c = interpolateDepth(Vector2::Zero);
+			plane.a = interpolateDepth(Vector2::UnitX) - plane.c;
+			plane.b = interpolateDepth(Vector2::UnitY) - plane.c;
 
-			finalColor += prevColor * (1.0f - diffuseColor.a) + diffuseColor * diffuseColor.a;
+			if (m_pDepthBuffer->TryCompressTile(tileIdx, plane))
+				return;
 		}
+	}
 
+	m_pDepthBuffer->DecompressTile(tileIdx);
 
-		UpdateColorInBuffer(static_cast<int>(pixel.position.x), static_cast<int>(pixel.position.y), finalColor, true);
 
-		return;
+	//Four pixels of a row per iteration, same operation order as RenderMeshTriangle so both agree on the depth
+	const __m128 v0X{ _mm_set1_ps(v0.x) }, v0Y{ _mm_set1_ps(v0.y) };
+	const __m128 v1X{ _mm_set1_ps(v1.x) }, v1Y{ _mm_set1_ps(v1.y) };
+	const __m128 v2X{ _mm_set1_ps(v2.x) }, v2Y{ _mm_set1_ps(v2.y) };
+
+	const __m128 edge01X{ _mm_set1_ps(edgeV0V1.x) }, edge01Y{ _mm_set1_ps(edgeV0V1.y) };
+	const __m128 edge12X{ _mm_set1_ps(edgeV1V2.x) }, edge12Y{ _mm_set1_ps(edgeV1V2.y) };
+	const __m128 edge20X{ _mm_set1_ps(edgeV2V0.x) }, edge20Y{ _mm_set1_ps(edgeV2V0.y) };
+
+	const __m128 depth0V{ _mm_set1_ps(depth0) }, depth1V{ _mm_set1_ps(depth1) }, depth2V{ _mm_set1_ps(depth2) };
+	const __m128 invTriangleAreaV{ _mm_set1_ps(invTriangleArea) };
+
+	const __m128 zero{ _mm_setzero_ps() };
+	const __m128 one{ _mm_set1_ps(1.f) };
+	const __m128 laneOffsets{ _mm_set_ps(3.f, 2.f, 1.f, 0.f) };
+
+	const Mesh::CullMode cullMode{ pMesh->GetCullMode() };
+	const bool writeDepth{ !pMesh->IsTransparent() };
+
+	const int startX{ static_cast<int>(minBoundingBox.x) };
+
+	for (int py{ static_cast<int>(minBoundingBox.y) }; py < maxBoundingBox.y; ++py)
+	{
+		const __m128 pixelY{ _mm_set1_ps(static_cast<float>(py)) };
+
+		for (int px{ startX }; px < maxBoundingBox.x; px += 4)
+		{
+			const __m128 pixelX{ _mm_add_ps(_mm_set1_ps(static_cast<float>(px)), laneOffsets) };
+
+			const __m128 edge0{ _mm_sub_ps(_mm_mul_ps(_mm_sub_ps(pixelX, v0X), edge01Y), _mm_mul_ps(_mm_sub_ps(pixelY, v0Y), edge01X)) };
+			const __m128 edge1{ _mm_sub_ps(_mm_mul_ps(_mm_sub_ps(pixelX, v1X), edge12Y), _mm_mul_ps(_mm_sub_ps(pixelY, v1Y), edge12X)) };
+			const __m128 edge2{ _mm_sub_ps(_mm_mul_ps(_mm_sub_ps(pixelX, v2X), edge20Y), _mm_mul_ps(_mm_sub_ps(pixelY, v2Y), edge20X)) };
+
+			for (int sample{}; sample < sampleCount; ++sample)
+			{
+				const Vector2 sampleOffset{ PixelLayout::GetSampleOffset(sampleCount, sample) };
+
+				const __m128 sampleEdge0{ _mm_add_ps(edge0, _mm_set1_ps(Vector2::Cross(sampleOffset, edgeV0V1))) };
+				const __m128 sampleEdge1{ _mm_add_ps(edge1, _mm_set1_ps(Vector2::Cross(sampleOffset, edgeV1V2))) };
+				const __m128 sampleEdge2{ _mm_add_ps(edge2, _mm_set1_ps(Vector2::Cross(sampleOffset, edgeV2V0))) };
+
+				const __m128 allPositive{ _mm_and_ps(_mm_and_ps(_mm_cmpgt_ps(sampleEdge0, zero), _mm_cmpgt_ps(sampleEdge1, zero)), _mm_cmpgt_ps(sampleEdge2, zero)) };
+				const __m128 allNegative{ _mm_and_ps(_mm_and_ps(_mm_cmplt_ps(sampleEdge0, zero), _mm_cmplt_ps(sampleEdge1, zero)), _mm_cmplt_ps(sampleEdge2, zero)) };
+
+				__m128 inside{};
+
+				switch (cullMode)
+				{
+				case Mesh::CullMode::Front:
+					inside = allPositive;
+					break;
+				case Mesh::CullMode::Back:
+					inside = allNegative;
+					break;
+				default:
+					inside = _mm_or_ps(allPositive, allNegative);
+					break;
+				}
+
+				const __m128 depth{ _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(sampleEdge1, depth0V), _mm_mul_ps(sampleEdge2, depth1V)), _mm_mul_ps(sampleEdge0, depth2V)), invTriangleAreaV) };
+				inside = _mm_and_ps(inside, _mm_and_ps(_mm_cmpge_ps(depth, zero), _mm_cmple_ps(depth, one)));
+
+				int laneMask{ _mm_movemask_ps(inside) };
+
+				if (laneMask == 0) continue;
+
+
+				//The depth formats and pixel layouts differ too much for a vector store, covered lanes go one by one
+				alignas(16) float depths[4];
+				_mm_store_ps(depths, depth);
+
+				while (laneMask)
+				{
+					const int lane{ std::countr_zero(static_cast<unsigned>(laneMask)) };
+					laneMask &= laneMask - 1;
+
+					if (px + lane >= tileMax.x) break;
+
+					m_pDepthBuffer->TestAndWrite(m_PixelLayout.ToSampleIndex(m_PixelLayout.ToIndex(px + lane, py), sample), depths[lane], writeDepth);
+				}
+			}
+		}
 	}
+}
+
+void dae::SoftwareRasterizer::VisualizeDepthBuffer()
+{
+	const int sampleCount{ m_PixelLayout.sampleCount };
+	const bool isReversedZ{ m_pDepthBuffer->IsReversedZ() };
+
+	concurrency::parallel_for(0, static_cast<int>(m_TileCleared.size()),
+		[&](int tileIdx)
+		{
+			if (!m_TileCleared[tileIdx] || !m_TileDirty[tileIdx])
+				return;
+
+			m_pDepthBuffer->DecompressTile(tileIdx);
+
+			Int2 tileMin{}, tileMax{};
+			GetTileBounds(tileIdx, tileMin, tileMax);
+
+			for (int py{ tileMin.y }; py < tileMax.y; ++py)
+			{
+				for (int px{ tileMin.x }; px < tileMax.x; ++px)
+				{
+					const int pixelIdx{ m_PixelLayout.ToIndex(px, py) };
+
+					for (int sample{}; sample < sampleCount; ++sample)
+					{
+						const int sampleIdx{ m_PixelLayout.ToSampleIndex(pixelIdx, sample) };
+						const float depth{ m_pDepthBuffer->Load(sampleIdx) };
+						const float viewDepth{ isReversedZ ? 1.f - depth : depth };
 
+						//Still at the far plane, the clear color shows through
+						if (viewDepth >= 1.f) continue;
 
+						const float depthCol{ Remap(viewDepth, 0.985f, 1.f) };
+						m_pColorBufferPixels[sampleIdx] = ColorRGB{ depthCol, depthCol, depthCol, 1.f };
+					}
+				}
+			}
+		});
+}
+
+
+void dae::SoftwareRasterizer::PixelShading(const Vertex_Out& pixel, const Mesh* pMesh, int pixelIdx, uint32_t coverageMask) const
+{
+	//Color
+	ColorRGB finalColor{};
+
+
+	const float lightIntensity{ 7.f };
+	const float kd{ 1.f };
+	const float shininess{ 25.f };
+	Vector3 sampledNormal{ pixel.normal };
+	const ColorRGB ambient{ 0.025f, 0.025f, 0.025f };
 
 
 	if (m_UseNormalMaps)
@@ -410,8 +1246,10 @@ void dae::SoftwareRasterizer::PixelShading(const Vertex_Out& pixel, const Mesh*
 		ColorRGB sampledNormalRGB{ pMesh->GetNormalMap()->Sample(pixel.uv) };
 		sampledNormalRGB = 2.f * sampledNormalRGB - ColorRGB{1.f, 1.f, 1.f};
 
+		//z is rebuilt from the unit length, two channel (BC5) normal maps only store x and y
+		const float sampledNormalZ{ std::sqrt(std::clamp(1.f - sampledNormalRGB.r * sampledNormalRGB.r - sampledNormalRGB.g * sampledNormalRGB.g, 0.f, 1.f)) };
 
-		sampledNormal = Vector3{ sampledNormalRGB.r, sampledNormalRGB.g, sampledNormalRGB.b };
+		sampledNormal = Vector3{ sampledNormalRGB.r, sampledNormalRGB.g, sampledNormalZ };
 		sampledNormal = tangentSpaceAxis.TransformVector(sampledNormal);
 		sampledNormal.Normalize();
 	}
@@ -453,82 +1291,214 @@ void dae::SoftwareRasterizer::PixelShading(const Vertex_Out& pixel, const Mesh*
 
 
 
-	UpdateColorInBuffer(static_cast<int>(pixel.position.x), static_cast<int>(pixel.position.y), finalColor);
+	UpdateColorInBuffer(pixelIdx, coverageMask, finalColor);
 
 }
 
-void dae::SoftwareRasterizer::UpdateColorInBuffer(int px, int py, ColorRGB& color, bool isTransparent) const
+void dae::SoftwareRasterizer::TransparentShading(int pixelIdx, uint32_t coverageMask, ColorRGB& diffuseColor, float viewDepth) const
 {
-	ColorRGB finalColor{ color };
-
-	if (isTransparent )
-		finalColor.MaxToOne();
+	if (m_IsOITEnabled)
+		AccumulateTransparency(pixelIdx, coverageMask, diffuseColor, viewDepth);
 	else
+		UpdateColorInBuffer(pixelIdx, coverageMask, diffuseColor, true);
+}
+
+void dae::SoftwareRasterizer::UpdateColorInBuffer(int pixelIdx, uint32_t coverageMask, ColorRGB& color, bool isTransparent) const
+{
+	//The color was shaded once, every covered sample of the pixel gets a copy
+	for (int sample{}; sample < m_PixelLayout.sampleCount; ++sample)
 	{
-		switch (m_ColorShadingMode)
+		if (!(coverageMask & (1u << sample))) continue;
+
+		ColorRGB& bufferColor{ m_pColorBufferPixels[m_PixelLayout.ToSampleIndex(pixelIdx, sample)] };
+
+		if (isTransparent)
 		{
-		case ColorShadingMode::Gamma:
-			finalColor = ApplyGammaCorrection(color);
-			break;
-		case ColorShadingMode::MaxToOne:
-			finalColor.MaxToOne();
-			break;
-		case ColorShadingMode::Filmic:
-			finalColor = ApplyFilmicToneMapping(color);
-			break;
+			// Premultiplied "over" in linear space, coverage accumulates in the alpha channel
+			const float alpha{ color.a };
+			const float prevAlpha{ bufferColor.a };
 
+			bufferColor = color * alpha + bufferColor * (1.f - alpha);
+			bufferColor.a = alpha + prevAlpha * (1.f - alpha);
+			continue;
 		}
+
+		bufferColor = ColorRGB{ color.r, color.g, color.b, 1.f };
 	}
+}
+
+void dae::SoftwareRasterizer::AccumulateTransparency(int pixelIdx, uint32_t coverageMask, const ColorRGB& color, float viewDepth) const
+{
+	// Weighted blended OIT (McGuire & Bavoil), closer surfaces get a larger weight
+	// Both sums are order independent, so transparent triangles need no sorting
+	const float alpha{ color.a };
+	const float depthWeight{ 10.f / (1e-5f + std::pow(viewDepth / 5.f, 2.f) + std::pow(viewDepth / 200.f, 6.f)) };
+	const float weight{ alpha * Clamp(depthWeight, 1e-2f, 3e3f) };
 
+	for (int sample{}; sample < m_PixelLayout.sampleCount; ++sample)
+	{
+		if (!(coverageMask & (1u << sample))) continue;
 
+		const int sampleIdx{ m_PixelLayout.ToSampleIndex(pixelIdx, sample) };
 
-	finalColor.r = std::max(0.0f, std::min(finalColor.r, 1.0f));
-	finalColor.g = std::max(0.0f, std::min(finalColor.g, 1.0f));
-	finalColor.b = std::max(0.0f, std::min(finalColor.b, 1.0f));
+		ColorRGB& accumulation{ m_pAccumulationPixels[sampleIdx] };
+		const float prevWeight{ accumulation.a };
 
+		accumulation += color * weight;
+		accumulation.a = prevWeight + weight;
 
-	m_pBackBufferPixels[px + (py * m_Width)] = SDL_MapRGB(m_pBackBuffer->format,
-		static_cast<uint8_t>(finalColor.r * 255),
-		static_cast<uint8_t>(finalColor.g * 255),
-		static_cast<uint8_t>(finalColor.b * 255));
+		m_pRevealagePixels[sampleIdx] *= 1.f - alpha;
+	}
 }
 
-dae::ColorRGB dae::SoftwareRasterizer::ApplyGammaCorrection(const ColorRGB& color) const
+void dae::SoftwareRasterizer::ResolveColorBuffer(const ColorRGB& clearColor) const
 {
-	ColorRGB correctedColor;
-	correctedColor.r = std::pow(color.r, m_GammaCorrection);
-	correctedColor.g = std::pow(color.g, m_GammaCorrection);
-	correctedColor.b = std::pow(color.b, m_GammaCorrection);
-	return correctedColor;
-}
+	// Format lookups happen once per frame instead of once per pixel write
+	const SDL_PixelFormat* pFormat{ m_pBackBuffer->format };
+	const uint32_t redShift{ pFormat->Rshift };
+	const uint32_t greenShift{ pFormat->Gshift };
+	const uint32_t blueShift{ pFormat->Bshift };
 
+	const __m128 zero{ _mm_setzero_ps() };
+	const __m128 one{ _mm_set1_ps(1.f) };
+	const __m128 maxColorValue{ _mm_set1_ps(255.f) };
 
-// Not really finished
-dae::ColorRGB dae::SoftwareRasterizer::ApplyFilmicToneMapping(const dae::ColorRGB& color) const
-{
+	const auto packColor = [&](const ColorRGB& color)
+		{
+			// ColorRGB is 4 packed floats, so clamp and scale all channels in one go
+			__m128 channels{ _mm_loadu_ps(&color.r) };
+			channels = _mm_mul_ps(_mm_min_ps(_mm_max_ps(channels, zero), one), maxColorValue);
+
+			alignas(16) int32_t packed[4];
+			_mm_store_si128(reinterpret_cast<__m128i*>(packed), _mm_cvttps_epi32(channels));
+
+			return (static_cast<uint32_t>(packed[0]) << redShift)
+				| (static_cast<uint32_t>(packed[1]) << greenShift)
+				| (static_cast<uint32_t>(packed[2]) << blueShift);
+		};
+
+	const auto mapColor = [&](const ColorRGB& hdrColor)
+		{
+			if (m_ColorShadingMode != ColorShadingMode::MaxToOne)
+				return m_ToneMapper.Map(hdrColor);
+
+			ColorRGB color{ hdrColor };
+			color.MaxToOne();
+			return color;
+		};
+
+	//The clear color is linear like the rendered colors, so the background goes through the same curve
+	const ColorRGB mappedClearColor{ mapColor(clearColor) };
+	const uint32_t packedClearColor{ packColor(mappedClearColor) };
 
+	const int sampleCount{ m_PixelLayout.sampleCount };
+	const float invSampleCount{ 1.f / sampleCount };
 
-	const float A = 0.15f;
-	const float B = 0.50f;
-	const float C = 0.10f;
-	const float D = 0.20f;
-	const float E = 0.02f;
-	const float F = 0.30f;
+	concurrency::parallel_for(0, static_cast<int>(m_TileCleared.size()),
+		[&](int tileIdx)
+		{
+			//FXAA filters the whole backbuffer in place, so it needs every tile freshly resolved from the kept color buffer
+			if (!m_TileDirty[tileIdx] && !m_IsFXAAEnabled)
+				return;
+
+			Int2 tileMin{}, tileMax{};
+			GetTileBounds(tileIdx, tileMin, tileMax);
 
+			const int tileWidth{ tileMax.x - tileMin.x };
+
+			//Nothing was drawn here, the color and depth buffer still hold stale data
+			if (!m_TileCleared[tileIdx])
+			{
+				for (int py{ tileMin.y }; py < tileMax.y; ++py)
+					std::fill_n(m_pBackBufferPixels + tileMin.x + py * m_Width, tileWidth, packedClearColor);
 
-	ColorRGB mappedColor;
-	mappedColor.r = ((color.r * (A * color.r + C * B) + D * E) / (color.r * (A * color.r + B) + D * F)) - E / F;
-	mappedColor.g = ((color.g * (A * color.g + C * B) + D * E) / (color.g * (A * color.g + B) + D * F)) - E / F;
-	mappedColor.b = ((color.b * (A * color.b + C * B) + D * E) / (color.b * (A * color.b + B) + D * F)) - E / F;
+				return;
+			}
 
-	mappedColor *= 3;
+			//The internal layout is swizzled back to the linear window layout here
+			for (int py{ tileMin.y }; py < tileMax.y; ++py)
+			{
+				uint32_t* pDst{ m_pBackBufferPixels + py * m_Width };
 
-	return mappedColor;
+				for (int px{ tileMin.x }; px < tileMax.x; ++px)
+				{
+					const ColorRGB* pSamples{ m_pColorBufferPixels + m_PixelLayout.ToSampleIndex(m_PixelLayout.ToIndex(px, py), 0) };
+
+					// Samples are tonemapped before averaging, so bright edges do not alias back in
+					ColorRGB finalColor{ 0.f, 0.f, 0.f, 0.f };
+					bool isCovered{ false };
+
+					for (int sample{}; sample < sampleCount; ++sample)
+					{
+						ColorRGB hdrColor{ pSamples[sample] };
+
+						if (m_IsOITEnabled)
+						{
+							const int sampleIdx{ static_cast<int>(pSamples - m_pColorBufferPixels) + sample };
+							const ColorRGB& accumulation{ m_pAccumulationPixels[sampleIdx] };
+							const float revealage{ m_pRevealagePixels[sampleIdx] };
+
+							// Weighted average of the transparent layers over the opaque color, in linear space
+							if (revealage < 1.f)
+							{
+								const ColorRGB averageColor{ accumulation * (1.f / std::max(accumulation.a, 1e-5f)) };
+								const float opaqueAlpha{ hdrColor.a };
+
+								hdrColor = averageColor * (1.f - revealage) + hdrColor * revealage;
+								hdrColor.a = (1.f - revealage) + opaqueAlpha * revealage;
+							}
+						}
+
+						if (hdrColor.a <= 0.f)
+						{
+							finalColor += mappedClearColor;
+							continue;
+						}
+
+						// Partially covered samples let the clear color show through, composited in linear space before the curve
+						finalColor += mapColor(hdrColor + clearColor * (1.f - hdrColor.a));
+						isCovered = true;
+					}
+
+					if (!isCovered)
+					{
+						pDst[px] = packedClearColor;
+						continue;
+					}
+
+					pDst[px] = packColor(finalColor * invSampleCount);
+				}
+			}
+		});
+}
+
+void dae::SoftwareRasterizer::UpdateToneMapper()
+{
+	// MaxToOne depends on all three channels at once, so it is applied in the resolve instead
+	constexpr float displayExponent{ 1.f / 2.2f };
+
+	switch (m_ColorShadingMode)
+	{
+	case ColorShadingMode::Gamma:
+		m_ToneMapper.Build(ToneMapper::Operator::Gamma, m_GammaCorrection);
+		break;
+	case ColorShadingMode::Reinhard:
+		m_ToneMapper.Build(ToneMapper::Operator::Reinhard, displayExponent);
+		break;
+	case ColorShadingMode::Filmic:
+		m_ToneMapper.Build(ToneMapper::Operator::Filmic, displayExponent);
+		break;
+	case ColorShadingMode::ACES:
+		m_ToneMapper.Build(ToneMapper::Operator::ACES, displayExponent);
+		break;
+	}
 }
 
 
 void dae::SoftwareRasterizer::NextShadingMode()
 {
+	m_IsFullRedrawNeeded = true;
+
 	// Shuffle through all the lighting modes
 	m_ShadingMode = static_cast<ShadingMode>((static_cast<int>(m_ShadingMode) + 1) % (static_cast<int>(ShadingMode::COUNT)));
 
@@ -552,6 +1522,8 @@ void dae::SoftwareRasterizer::NextShadingMode()
 
 void dae::SoftwareRasterizer::ToggleRenderMode()
 {
+	m_IsFullRedrawNeeded = true;
+
 	m_RenderMode = static_cast<RenderMode>((static_cast<int>(m_RenderMode) + 1) % (static_cast<int>(RenderMode::COUNT)));
 
 	if (m_RenderMode == RenderMode::Default)
@@ -562,6 +1534,8 @@ void dae::SoftwareRasterizer::ToggleRenderMode()
 
 void dae::SoftwareRasterizer::ToggleNormalMap()
 {
+	m_IsFullRedrawNeeded = true;
+
 	m_UseNormalMaps = !m_UseNormalMaps;
 
 
@@ -573,6 +1547,8 @@ void dae::SoftwareRasterizer::ToggleNormalMap()
 
 void dae::SoftwareRasterizer::ToggleBoundingBox()
 {
+	m_IsFullRedrawNeeded = true;
+
 	m_IsShowingBoundingBoxes = !m_IsShowingBoundingBoxes;
 
 
@@ -584,6 +1560,7 @@ void dae::SoftwareRasterizer::ToggleBoundingBox()
 
 void dae::SoftwareRasterizer::NextColorShadingMode()
 {
+	m_IsFullRedrawNeeded = true;
 
 	m_ColorShadingMode = static_cast<ColorShadingMode>((static_cast<int>(m_ColorShadingMode) + 1) % (static_cast<int>(ColorShadingMode::COUNT)));
 
@@ -596,11 +1573,19 @@ void dae::SoftwareRasterizer::NextColorShadingMode()
 	case ColorShadingMode::MaxToOne:
 		std::cout << "COLOR SHADING MODE: Max To One" << "\n";
 		break;
+	case ColorShadingMode::Reinhard:
+		std::cout << "COLOR SHADING MODE: Reinhard ToneMapping" << "\n";
+		break;
 	case ColorShadingMode::Filmic:
 		std::cout << "COLOR SHADING MODE: Filmic ToneMapping" << "\n";
 		break;
+	case ColorShadingMode::ACES:
+		std::cout << "COLOR SHADING MODE: ACES ToneMapping" << "\n";
+		break;
 	}
 
+	UpdateToneMapper();
+
 
 	//m_IsGammaCorrectionEnabled = !m_IsGammaCorrectionEnabled;
 
@@ -612,8 +1597,139 @@ void dae::SoftwareRasterizer::NextColorShadingMode()
 
 }
 
+void dae::SoftwareRasterizer::NextDepthFormat()
+{
+	m_IsFullRedrawNeeded = true;
+
+	const DepthBuffer::Format format{ static_cast<DepthBuffer::Format>((static_cast<int>(m_pDepthBuffer->GetFormat()) + 1) % (static_cast<int>(DepthBuffer::Format::COUNT))) };
+	m_pDepthBuffer->SetFormat(format);
+
+	switch (format)
+	{
+	case DepthBuffer::Format::Float32:
+		std::cout << "DEPTH FORMAT: Float32" << "\n";
+		break;
+	case DepthBuffer::Format::Unorm24:
+		std::cout << "DEPTH FORMAT: Unorm24" << "\n";
+		break;
+	case DepthBuffer::Format::Unorm16:
+		std::cout << "DEPTH FORMAT: Unorm16" << "\n";
+		break;
+	}
+}
+
+void dae::SoftwareRasterizer::ToggleReversedZ()
+{
+	m_IsFullRedrawNeeded = true;
+
+	m_pDepthBuffer->SetReversedZ(!m_pDepthBuffer->IsReversedZ());
+
+	if (m_pDepthBuffer->IsReversedZ())
+		std::cout << "REVERSED Z: Enabled" << '\n';
+	else
+		std::cout << "REVERSED Z: Disabled" << '\n';
+}
+
+void dae::SoftwareRasterizer::ToggleDepthCompression()
+{
+	m_IsFullRedrawNeeded = true;
+
+	m_pDepthBuffer->SetCompression(!m_pDepthBuffer->IsCompressionEnabled());
+
+	if (m_pDepthBuffer->IsCompressionEnabled())
+		std::cout << "DEPTH COMPRESSION: Enabled" << '\n';
+	else
+		std::cout << "DEPTH COMPRESSION: Disabled" << '\n';
+}
+
+void dae::SoftwareRasterizer::NextPixelLayout()
+{
+	m_IsFullRedrawNeeded = true;
+
+	m_PixelLayout.mode = static_cast<PixelLayout::Mode>((static_cast<int>(m_PixelLayout.mode) + 1) % (static_cast<int>(PixelLayout::Mode::COUNT)));
+	m_pDepthBuffer->SetLayout(m_PixelLayout);
+
+	switch (m_PixelLayout.mode)
+	{
+	case PixelLayout::Mode::Linear:
+		std::cout << "FRAMEBUFFER LAYOUT: Linear" << "\n";
+		break;
+	case PixelLayout::Mode::Tiled:
+		std::cout << "FRAMEBUFFER LAYOUT: Tiled" << "\n";
+		break;
+	case PixelLayout::Mode::Morton:
+		std::cout << "FRAMEBUFFER LAYOUT: Morton" << "\n";
+		break;
+	}
+}
+
+void dae::SoftwareRasterizer::ToggleMultisampling()
+{
+	m_IsFullRedrawNeeded = true;
+
+	m_PixelLayout.sampleCount = m_PixelLayout.sampleCount == 1 ? PixelLayout::MaxSampleCount : 1;
+
+	m_pDepthBuffer->SetLayout(m_PixelLayout);
+	AllocateColorBuffer();
+
+	if (m_PixelLayout.sampleCount > 1)
+		std::cout << "MULTISAMPLING: " << m_PixelLayout.sampleCount << "x" << '\n';
+	else
+		std::cout << "MULTISAMPLING: Disabled" << '\n';
+}
+
+void dae::SoftwareRasterizer::ToggleFXAA()
+{
+	m_IsFullRedrawNeeded = true;
+
+	m_IsFXAAEnabled = !m_IsFXAAEnabled;
+
+	if (m_IsFXAAEnabled)
+		std::cout << "FXAA: Enabled" << '\n';
+	else
+		std::cout << "FXAA: Disabled" << '\n';
+}
+
+void dae::SoftwareRasterizer::ToggleOIT()
+{
+	m_IsFullRedrawNeeded = true;
+
+	m_IsOITEnabled = !m_IsOITEnabled;
+
+	if (m_IsOITEnabled)
+		std::cout << "ORDER INDEPENDENT TRANSPARENCY: Enabled" << '\n';
+	else
+		std::cout << "ORDER INDEPENDENT TRANSPARENCY: Disabled" << '\n';
+}
+
+void dae::SoftwareRasterizer::ToggleDepthPrepass()
+{
+	m_IsFullRedrawNeeded = true;
+
+	m_IsDepthPrepassEnabled = !m_IsDepthPrepassEnabled;
+
+	if (m_IsDepthPrepassEnabled)
+		std::cout << "DEPTH PREPASS: Enabled" << '\n';
+	else
+		std::cout << "DEPTH PREPASS: Disabled" << '\n';
+}
+
+void dae::SoftwareRasterizer::ToggleMeshletCulling()
+{
+	m_IsFullRedrawNeeded = true;
+
+	m_IsMeshletCullingEnabled = !m_IsMeshletCullingEnabled;
+
+	if (m_IsMeshletCullingEnabled)
+		std::cout << "MESHLET CULLING: Enabled" << '\n';
+	else
+		std::cout << "MESHLET CULLING: Disabled" << '\n';
+}
+
 void dae::SoftwareRasterizer::AdjustGammaCorrection(bool lowerIt)
 {
+	m_IsFullRedrawNeeded = true;
+
 	if (lowerIt && m_GammaCorrection > 0.f)
 	{
 		m_GammaCorrection -= 0.2f;
@@ -624,4 +1740,21 @@ void dae::SoftwareRasterizer::AdjustGammaCorrection(bool lowerIt)
 		m_GammaCorrection += 0.2f;
 		std::cout << "GAMMA CORRECTION RAISED: " + std::to_string(m_GammaCorrection) << '\n';
 	}
+
+	UpdateToneMapper();
+}
+
+void dae::SoftwareRasterizer::ToggleDirtyTiles()
+{
+	m_IsDirtyTileRenderingEnabled = !m_IsDirtyTileRenderingEnabled;
+
+	if (m_IsDirtyTileRenderingEnabled)
+		std::cout << "DIRTY TILES: Enabled" << '\n';
+	else
+		std::cout << "DIRTY TILES: Disabled" << '\n';
+}
+
+void dae::SoftwareRasterizer::InvalidateFrame()
+{
+	m_IsFullRedrawNeeded = true;
 }
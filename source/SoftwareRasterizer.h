@@ -2,10 +2,13 @@
 
 
 #include <cstdint>
+#include <unordered_map>
 #include <vector>
 
 #include "Camera.h"
 #include "DataTypes.h"
+#include "ToneMapping.h"
+#include "PixelLayout.h"
 
 struct SDL_Window;
 struct SDL_Surface;
@@ -14,9 +17,12 @@ namespace dae
 {
 	class Texture;
 	class Mesh;
+	class MeshInstance;
 	struct Vertex;
 	class Timer;
 	class Scene;
+	class DepthBuffer;
+	class FXAA;
 
 	class SoftwareRasterizer final
 	{
@@ -32,7 +38,8 @@ namespace dae
 
 		void Update(Timer* pTimer);
 
-		void SoftwareRender(std::vector<Mesh*>& pMeshes, Camera& camera, bool isBackgroundUniform) const;
+		// Consecutive instances of the same mesh are culled and transformed as one batch
+		void SoftwareRender(const std::vector<MeshInstance*>& pInstances, Camera& camera, bool isBackgroundUniform);
 
 		bool SaveBufferToImage() const;
 
@@ -46,6 +53,20 @@ namespace dae
 
 		void AdjustGammaCorrection(bool lowerIt);
 
+		void NextDepthFormat();
+		void ToggleReversedZ();
+		void ToggleDepthCompression();
+		void NextPixelLayout();
+		void ToggleMultisampling();
+		void ToggleFXAA();
+		void ToggleOIT();
+		void ToggleDepthPrepass();
+		void ToggleMeshletCulling();
+		void ToggleDirtyTiles();
+
+		// Every tile is drawn again next frame, for changes the rasterizer can not see itself like new textures or cull modes
+		void InvalidateFrame();
+
 
 
 	private:
@@ -54,7 +75,9 @@ namespace dae
 		{
 			Gamma,
 			MaxToOne,
+			Reinhard,
 			Filmic,
+			ACES,
 
 			COUNT
 		};
@@ -90,7 +113,56 @@ namespace dae
 		SDL_Surface* m_pBackBuffer{ nullptr };
 
 		uint32_t* m_pBackBufferPixels{};
-		float* m_pDepthBufferPixels{};
+		DepthBuffer* m_pDepthBuffer{};
+
+		// Linear HDR color target, resolved into m_pBackBufferPixels once per frame
+		// The alpha channel holds the coverage, 0 means the clear color shows through
+		// Holds m_PixelLayout.sampleCount samples per pixel, shading still runs once per pixel
+		ColorRGB* m_pColorBufferPixels{};
+
+		// Weighted blended OIT targets, same layout as the color buffer
+		// Accumulation holds the weighted premultiplied color with the summed weight in alpha
+		// Revealage is the product of (1 - alpha) of every transparent layer
+		ColorRGB* m_pAccumulationPixels{};
+		float* m_pRevealagePixels{};
+		bool m_IsOITEnabled{ false };
+
+		// Screen tiles, each one is rasterized, cleared and resolved by a single job
+		// Must be a power of two for the tiled pixel layouts
+		static constexpr int m_TileSize{ 32 };
+		int m_NrTilesX{};
+		int m_NrTilesY{};
+
+		PixelLayout m_PixelLayout{};
+
+		std::vector<uint8_t> m_TileCleared{};
+		std::vector<std::vector<uint32_t>> m_TileBins{};
+
+		// Only tiles under an instance that moved, appeared or disappeared are cleared and drawn again, the others keep last frame
+		// A moving camera or a changed setting makes every tile dirty
+		bool m_IsDirtyTileRenderingEnabled{ true };
+		bool m_IsFullRedrawNeeded{ true };
+		std::vector<uint8_t> m_TileDirty{};
+
+		struct DrawnInstance
+		{
+			const Mesh* pMesh{};
+			Matrix worldMatrix{};
+			int lodLevel{};
+
+			// Inclusive tile range of the screen bounds, empty when tileMax is below tileMin
+			Int2 tileMin{};
+			Int2 tileMax{};
+		};
+
+		// What was drawn the last frame, to compare the current one against
+		std::unordered_map<const MeshInstance*, DrawnInstance> m_DrawnInstances{};
+		Matrix m_DrawnViewProjectionMatrix{};
+		bool m_WasBackgroundUniform{ false };
+
+		// Post process antialiasing on the resolved backbuffer
+		FXAA* m_pFXAA{};
+		bool m_IsFXAAEnabled{ false };
 
 
 		int m_Width{};
@@ -101,28 +173,88 @@ namespace dae
 		float m_GammaCorrection{1.6f};
 		bool m_IsGammaCorrectionEnabled{ true } ;
 
+		ToneMapper m_ToneMapper{};
+
 
 		bool m_IsShowingBoundingBoxes{ false };
 
+		// Opaque meshes fill the depth buffer first and then shade only samples matching it
+		bool m_IsDepthPrepassEnabled{ false };
+
+		enum class RasterPass
+		{
+			// Depth test and shading in one go
+			Full,
+
+			// The prepass, fills in the depth of every opaque instance before anything is shaded
+			Depth,
+
+			// Shades only the samples whose depth matches what the prepass left
+			Shade
+		};
+
+		// Per instance cluster culling results of the batch being rendered
+		bool m_IsMeshletCullingEnabled{ true };
+		std::vector<std::vector<uint32_t>> m_VisibleMeshlets{};
+		std::vector<std::vector<uint8_t>> m_VertexMasks{};
+		std::vector<uint8_t> m_UsesMeshlets{};
+
+		// Vertices of the triangles BinMeshTriangles kept for the instance being rendered
+		std::vector<uint8_t> m_ReferencedVertices{};
+
 		bool CheckCullMode(const Mesh* pMesh, const float edge01, const float edge02, const float edge03) const;
 
-		void VertexTransformationFunction(Mesh* pMesh, Camera& camera) const;
+		// Transforms the positions of every instance of a batch in one parallel loop
+		// Vertices left out of an instance's mask in m_VertexMasks are not transformed, instances whose transform cache still matches not at all
+		void VertexTransformationFunction(MeshInstance* const* ppInstances, size_t nrInstances, const Camera& camera) const;
+
+		// Fills visibleMeshlets and vertexMask with the clusters that can show up on screen
+		void CullMeshlets(const MeshInstance* pInstance, const Camera& camera, std::vector<uint32_t>& visibleMeshlets, std::vector<uint8_t>& vertexMask) const;
+
+		void AllocateColorBuffer();
+
+		// Fills m_TileDirty and m_DrawnInstances for this frame
+		void UpdateDirtyTiles(const std::vector<MeshInstance*>& pInstances, const Camera& camera, bool isBackgroundUniform);
+		void GetInstanceTileBounds(const MeshInstance* pInstance, const Matrix& viewProjectionMatrix, Int2& tileMin, Int2& tileMax) const;
+		void MarkDirtyTiles(const Int2& tileMin, const Int2& tileMax);
+		bool HasDirtyTile(const Int2& tileMin, const Int2& tileMax) const;
 
-		void ResetDepthBufferAndClearBackground(bool isBackgroundUniform) const;
+		// Only the dirty tiles, the others keep their contents
+		void ResetTiles();
+		void ClearTile(int tileIdx);
+		void GetTileBounds(int tileIdx, Int2& tileMin, Int2& tileMax) const;
 
 		bool IsVertexInFrustrum(const Vector4& vertex, float min = -1.f, float max = 1.f) const;
 
-		void Render(Mesh* pMesh, Camera& camera) const;
+		// All instances of one mesh, culled and transformed together, then rasterized one after the other
+		void Render(MeshInstance* const* ppInstances, size_t nrInstances, Camera& camera, RasterPass pass);
+		void RenderInstance(MeshInstance* pInstance, const Camera& camera, const std::vector<uint32_t>* pVisibleMeshlets, RasterPass pass);
+
+		// Without visible meshlets every triangle of the instance's LOD is binned, the vertices of binned triangles are marked in m_ReferencedVertices
+		void BinMeshTriangles(const MeshInstance* pInstance, const std::vector<Vector2>& verticesScreen, const std::vector<uint32_t>* pVisibleMeshlets);
+
+		// Uv, normal, tangent and view direction of the vertices marked in m_ReferencedVertices
+		void ComputeVertexAttributes(MeshInstance* pInstance, const Camera& camera) const;
+
+		void RenderMeshTriangle(const MeshInstance* pInstance, const std::vector<Vector2>& verticesScreen, size_t currentVertexIdx, bool swapVertices, int tileIdx, const Int2& tileMin, const Int2& tileMax, bool isDepthPrepassed) const;
+
+		// Depth only rasterization without attribute setup, used for the prepass and the depth visualization
+		void RenderMeshTriangleDepth(const MeshInstance* pInstance, const std::vector<Vector2>& verticesScreen, size_t currentVertexIdx, bool swapVertices, int tileIdx, const Int2& tileMin, const Int2& tileMax) const;
+
+		// Turns the depth buffer into grey values in the color buffer
+		void VisualizeDepthBuffer();
+
+		void PixelShading(const Vertex_Out& pixel, const Mesh* pMesh, int pixelIdx, uint32_t coverageMask) const;
 
-		void RenderMeshTriangle(const Mesh* pMesh, const std::vector<Vector2>& verticesScreen, size_t currentVertexIdx, bool swapVertices = false) const;
+		void TransparentShading(int pixelIdx, uint32_t coverageMask, ColorRGB& diffuseColor, float viewDepth) const;
 
-		void PixelShading(const Vertex_Out& pixel, const Mesh* pMesh, int pixelIdx) const;
+		void UpdateColorInBuffer(int pixelIdx, uint32_t coverageMask, ColorRGB& finalColor, bool isTransparent = false) const;
 
-		void UpdateColorInBuffer(int px, int py, ColorRGB& finalColor, bool isTransparent = false) const;
+		void AccumulateTransparency(int pixelIdx, uint32_t coverageMask, const ColorRGB& color, float viewDepth) const;
 
+		void ResolveColorBuffer(const ColorRGB& clearColor) const;
 
-		ColorRGB ApplyGammaCorrection(const ColorRGB& color) const;
-		ColorRGB ApplyFilmicToneMapping(const ColorRGB& color) const;
+		void UpdateToneMapper();
 
 	};
 }
@@ -1,31 +1,80 @@
 #include "pch.h"
 #include "Texture.h"
+#include "BlockCompression.h"
+#include <atomic>
+
+
+namespace
+{
+	//Direct mapped, one per thread so the sampling threads never share or lock it
+	struct DecodedBlock
+	{
+		uint32_t textureId{};
+		uint32_t blockIndex{};
+		uint32_t texels[16]{};
+	};
+
+	constexpr uint32_t g_NrDecodedBlocks{ 64 };
+	thread_local DecodedBlock g_DecodedBlocks[g_NrDecodedBlocks]{};
+
+	//0 marks an empty cache entry
+	std::atomic<uint32_t> g_NextTextureId{ 1 };
+}
 
 namespace dae
 {
-	Texture::Texture(ID3D11Device* pDevice, SDL_Surface* pSurface)
-		: m_pSurface{ pSurface }
-		, m_pSurfacePixels{ static_cast<uint32_t*>(pSurface->pixels) }
+	Texture::Texture(ID3D11Device* pDevice, TextureContainer* pContainer)
+		: m_pContainer{ pContainer }
+		, m_Width{ pContainer->GetWidth() }
+		, m_Height{ pContainer->GetHeight() }
+		, m_Format{ pContainer->GetFormat() }
+		, m_pData{ pContainer->GetData() }
+		, m_NrBlocksX{ (pContainer->GetWidth() + 3) / 4 }
+		, m_Id{ g_NextTextureId++ }
 	{
-		DXGI_FORMAT format = DXGI_FORMAT_R8G8B8A8_UNORM;
+		BuildAlphaMask();
+
+		DXGI_FORMAT format{};
+
+		switch (m_Format)
+		{
+		case TextureContainer::Format::RGBA8:
+			format = DXGI_FORMAT_R8G8B8A8_UNORM;
+			break;
+		case TextureContainer::Format::BC1:
+			format = DXGI_FORMAT_BC1_UNORM;
+			break;
+		case TextureContainer::Format::BC3:
+			format = DXGI_FORMAT_BC3_UNORM;
+			break;
+		case TextureContainer::Format::BC5:
+			format = DXGI_FORMAT_BC5_UNORM;
+			break;
+		}
+
 		D3D11_TEXTURE2D_DESC desc{};
-		desc.Width = pSurface->w;
-		desc.Height = pSurface->h;
-		desc.MipLevels = 1;
+		desc.Width = m_Width;
+		desc.Height = m_Height;
+		desc.MipLevels = pContainer->GetMipCount();
 		desc.ArraySize = 1;
 		desc.Format = format;
 		desc.SampleDesc.Count = 1;
 		desc.SampleDesc.Quality = 0;
-		desc.Usage = D3D11_USAGE_DEFAULT;
+		desc.Usage = D3D11_USAGE_IMMUTABLE;
 		desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
 		desc.MiscFlags = 0;
 
-		D3D11_SUBRESOURCE_DATA initData;
-		initData.pSysMem = pSurface->pixels;
-		initData.SysMemPitch = static_cast<UINT>(pSurface->pitch);
-		initData.SysMemSlicePitch = static_cast<UINT>(pSurface->h * pSurface->pitch);
+		//Every mip straight from the container, blocks are uploaded as they are
+		std::vector<D3D11_SUBRESOURCE_DATA> initData(pContainer->GetMipCount());
+
+		for (int mipLevel{}; mipLevel < pContainer->GetMipCount(); ++mipLevel)
+		{
+			initData[mipLevel].pSysMem = pContainer->GetData(mipLevel);
+			initData[mipLevel].SysMemPitch = pContainer->GetRowPitch(mipLevel);
+			initData[mipLevel].SysMemSlicePitch = pContainer->GetDataSize(mipLevel);
+		}
 
-		HRESULT hr = pDevice->CreateTexture2D(&desc, &initData, &m_pResource);
+		HRESULT hr = pDevice->CreateTexture2D(&desc, initData.data(), &m_pResource);
 
 		if (FAILED(hr))
 		{
@@ -37,7 +86,7 @@ namespace dae
 		D3D11_SHADER_RESOURCE_VIEW_DESC SRVDesc{};
 		SRVDesc.Format = format;
 		SRVDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
-		SRVDesc.Texture2D.MipLevels = 1;
+		SRVDesc.Texture2D.MipLevels = pContainer->GetMipCount();
 
 		hr = pDevice->CreateShaderResourceView(m_pResource, &SRVDesc, &m_pSRV);
 		if (FAILED(hr))
@@ -45,9 +94,6 @@ namespace dae
 			std::wcout << L"Shader Resource View creation failed!\n";
 			return;
 		}
-
-		////Release pSurface, as it's not necessary anymore
-		//SDL_FreeSurface(pSurface);
 	}
 
 	Texture::~Texture()
@@ -55,11 +101,7 @@ namespace dae
 		if (m_pSRV) m_pSRV->Release();
 		if (m_pResource) m_pResource->Release();
 
-		if (m_pSurface)
-		{
-			SDL_FreeSurface(m_pSurface);
-			//m_pSurface = nullptr;
-		}
+		delete m_pContainer;
 	}
 
 	ID3D11ShaderResourceView* Texture::GetSRV() const
@@ -69,26 +111,108 @@ namespace dae
 
 	ColorRGB Texture::Sample(const Vector2& uv) const
 	{
-		
-		//const size_t x{ static_cast<size_t>(uv.x * m_pSurface->w) };
-		//const size_t y{ static_cast<size_t>(uv.y * m_pSurface->h) };
+		const int x{ std::min(static_cast<int>(std::clamp(uv.x, 0.0f, 1.0f) * m_Width), m_Width - 1) };
+		const int y{ std::min(static_cast<int>(std::clamp(uv.y, 0.0f, 1.0f) * m_Height), m_Height - 1) };
+
+		const uint32_t pixel{ FetchTexel(x, y) };
+
+		const float clampColorValue{ 1.f / 255.f };
 
-		const int x{ static_cast<int>(std::clamp(uv.x, 0.0f, 1.0f) * m_pSurface->w) };
-		const int y{ static_cast<int>(std::clamp(uv.y, 0.0f, 1.0f) * m_pSurface->h) };
+		return ColorRGB{ (pixel & 0xFF) * clampColorValue, ((pixel >> 8) & 0xFF) * clampColorValue, ((pixel >> 16) & 0xFF) * clampColorValue, (pixel >> 24) * clampColorValue };
+	}
 
-		uint8_t r{}, g{}, b{}, a{};
+	bool Texture::IsFullyTransparent(const Vector2& uv) const
+	{
+		if (m_AlphaMask.empty())
+			return false;
 
-		const Uint32 pixel{ m_pSurfacePixels[x + y * m_pSurface->w] };
+		const int x{ std::min(static_cast<int>(std::clamp(uv.x, 0.0f, 1.0f) * m_Width), m_Width - 1) };
+		const int y{ std::min(static_cast<int>(std::clamp(uv.y, 0.0f, 1.0f) * m_Height), m_Height - 1) };
 
-		SDL_GetRGBA(pixel, m_pSurface->format, &r, &g, &b, &a);
+		return !m_AlphaMask[(x >> m_AlphaBlockShift) + (y >> m_AlphaBlockShift) * m_NrAlphaBlocksX];
+	}
 
-		const float clampColorValue{ 1.f / 255.f };
+	void Texture::BuildAlphaMask()
+	{
+		if (!m_pContainer->HasAlpha())
+			return;
+
+		const int blockSize{ 1 << m_AlphaBlockShift };
+		m_NrAlphaBlocksX = (m_Width + blockSize - 1) / blockSize;
+		const int nrAlphaBlocksY{ (m_Height + blockSize - 1) / blockSize };
+
+		m_AlphaMask.assign(m_NrAlphaBlocksX * nrAlphaBlocksY, 0);
+
+		//Block by block, compressed blocks are decoded once
+		for (int blockY{}; blockY < m_Height; blockY += 4)
+		{
+			for (int blockX{}; blockX < m_Width; blockX += 4)
+			{
+				for (int y{ blockY }; y < std::min(blockY + 4, m_Height); ++y)
+				{
+					for (int x{ blockX }; x < std::min(blockX + 4, m_Width); ++x)
+					{
+						if ((FetchTexel(x, y) >> 24) > 0)
+							m_AlphaMask[(x >> m_AlphaBlockShift) + (y >> m_AlphaBlockShift) * m_NrAlphaBlocksX] = 1;
+					}
+				}
+			}
+		}
+	}
 
-		return ColorRGB{ r * clampColorValue, g * clampColorValue, b * clampColorValue, a * clampColorValue };
+	uint32_t Texture::FetchTexel(int x, int y) const
+	{
+		if (m_Format == TextureContainer::Format::RGBA8)
+			return reinterpret_cast<const uint32_t*>(m_pData)[x + y * m_Width];
+
+		const uint32_t blockIndex{ static_cast<uint32_t>((x >> 2) + (y >> 2) * m_NrBlocksX) };
+
+		DecodedBlock& decodedBlock{ g_DecodedBlocks[(blockIndex + m_Id * 2654435761u) & (g_NrDecodedBlocks - 1)] };
+
+		if (decodedBlock.textureId != m_Id || decodedBlock.blockIndex != blockIndex)
+		{
+			const uint8_t* pBlock{ m_pData + blockIndex * TextureContainer::GetBlockSize(m_Format) };
+
+			switch (m_Format)
+			{
+			case TextureContainer::Format::BC1:
+				BlockCompression::DecodeBC1(pBlock, decodedBlock.texels);
+				break;
+			case TextureContainer::Format::BC3:
+				BlockCompression::DecodeBC3(pBlock, decodedBlock.texels);
+				break;
+			case TextureContainer::Format::BC5:
+				BlockCompression::DecodeBC5(pBlock, decodedBlock.texels);
+				break;
+			}
+
+			decodedBlock.textureId = m_Id;
+			decodedBlock.blockIndex = blockIndex;
+		}
+
+		return decodedBlock.texels[(x & 3) + (y & 3) * 4];
 	}
 
-	Texture* Texture::LoadFromFile(ID3D11Device* pDevice, const std::string& path)
+	const TextureContainer* Texture::GetContainer() const
 	{
+		return m_pContainer;
+	}
+
+	Texture* Texture::LoadFromFile(ID3D11Device* pDevice, const std::string& path, TextureContainer::Format format)
+	{
+		TextureContainer* pContainer{ LoadContainer(path, format) };
+
+		return pContainer ? new Texture(pDevice, pContainer) : nullptr;
+	}
+
+	TextureContainer* Texture::LoadContainer(const std::string& path, TextureContainer::Format format)
+	{
+		const std::string containerPath{ TextureContainer::GetContainerPath(path, format) };
+
+		if (TextureContainer* pContainer{ TextureContainer::Load(containerPath, path, format) })
+			return pContainer;
+
+		//First load, or the image changed since the container was made
 		SDL_Surface* pSurface{ IMG_Load(path.c_str()) };
 		if (!pSurface)
 		{
@@ -96,6 +220,36 @@ namespace dae
 			return nullptr;
 		}
 
-		return new Texture(pDevice, pSurface);
+		TextureContainer* pContainer{ TextureContainer::Create(pSurface, format) };
+		SDL_FreeSurface(pSurface);
+
+		if (!pContainer)
+		{
+			std::wcout << L"Texture conversion failed!\n";
+			return nullptr;
+		}
+
+		//Still usable from memory when the container can not be written
+		if (!pContainer->Save(containerPath))
+			std::wcout << L"Texture container could not be written!\n";
+
+		return pContainer;
+	}
+
+	Texture* Texture::CreateSolidColor(ID3D11Device* pDevice, uint8_t r, uint8_t g, uint8_t b, uint8_t a)
+	{
+		SDL_Surface* pSurface{ SDL_CreateRGBSurfaceWithFormat(0, 1, 1, 32, SDL_PIXELFORMAT_ABGR8888) };
+		if (!pSurface)
+		{
+			std::wcout << L"Texture surface creation failed!\n";
+			return nullptr;
+		}
+
+		*static_cast<uint32_t*>(pSurface->pixels) = SDL_MapRGBA(pSurface->format, r, g, b, a);
+
+		TextureContainer* pContainer{ TextureContainer::Create(pSurface, TextureContainer::Format::RGBA8) };
+		SDL_FreeSurface(pSurface);
+
+		return pContainer ? new Texture(pDevice, pContainer) : nullptr;
 	}
 }
@@ -1,4 +1,5 @@
 #pragma once
+#include "TextureContainer.h"
 
 
 namespace dae
@@ -6,7 +7,8 @@ namespace dae
 	class Texture final
 	{
 	public:
-		Texture(ID3D11Device* pDevice, SDL_Surface* pSurface);
+		// Takes over the container, the CPU side samples its pixels or blocks in place
+		Texture(ID3D11Device* pDevice, TextureContainer* pContainer);
 		~Texture();
 		Texture(const Texture&) = delete;
 		Texture(Texture&&) = delete;
@@ -17,13 +19,45 @@ namespace dae
 
 		ColorRGB Sample(const Vector2& uv) const;
 
+		// Coarse test against the alpha mask, true means every texel of the block around uv has zero alpha
+		bool IsFullyTransparent(const Vector2& uv) const;
 
-		static Texture* LoadFromFile(ID3D11Device* pDevice, const std::string& path);
+
+		const TextureContainer* GetContainer() const;
+
+		// Uses the pre-decoded container next to the image, it is made on the first load and whenever the image or format changes
+		static Texture* LoadFromFile(ID3D11Device* pDevice, const std::string& path, TextureContainer::Format format = TextureContainer::Format::RGBA8);
+
+		// The CPU half of LoadFromFile, without any D3D resources
+		static TextureContainer* LoadContainer(const std::string& path, TextureContainer::Format format = TextureContainer::Format::RGBA8);
+
+		// 1x1 texture, stands in for a map that is still loading
+		static Texture* CreateSolidColor(ID3D11Device* pDevice, uint8_t r, uint8_t g, uint8_t b, uint8_t a);
 
 	private:
 
-		SDL_Surface* m_pSurface{ nullptr };
-		uint32_t* m_pSurfacePixels{ nullptr };
+		TextureContainer* m_pContainer{ nullptr };
+
+		int m_Width{};
+		int m_Height{};
+
+		TextureContainer::Format m_Format{};
+		const uint8_t* m_pData{ nullptr };
+		int m_NrBlocksX{};
+
+		// Tags this texture's blocks in the decoded block cache
+		uint32_t m_Id{};
+
+		// R, G, B, A bytes, block compressed texels go through a small per thread cache of decoded blocks
+		uint32_t FetchTexel(int x, int y) const;
+
+		// One entry per 8x8 texel block, 0 when the whole block has zero alpha
+		// Stays empty for textures without an alpha channel
+		static constexpr int m_AlphaBlockShift{ 3 };
+		int m_NrAlphaBlocksX{};
+		std::vector<uint8_t> m_AlphaMask{};
+
+		void BuildAlphaMask();
 
 
 		ID3D11Texture2D* m_pResource{ nullptr };
@@ -0,0 +1,426 @@
+#include "pch.h"
+#include "TextureContainer.h"
+#include "BlockCompression.h"
+#include <filesystem>
+#include <fstream>
+#include <Windows.h>
+
+
+dae::TextureContainer::~TextureContainer()
+{
+	if (m_pMappedView)
+		UnmapViewOfFile(m_pMappedView);
+}
+
+std::string dae::TextureContainer::GetContainerPath(const std::string& imagePath, Format format)
+{
+	switch (format)
+	{
+	case Format::BC1:
+		return imagePath + ".bc1.dtex";
+	case Format::BC3:
+		return imagePath + ".bc3.dtex";
+	case Format::BC5:
+		return imagePath + ".bc5.dtex";
+	default:
+		return imagePath + ".rgba8.dtex";
+	}
+}
+
+dae::TextureContainer* dae::TextureContainer::Load(const std::string& path, const std::string& imagePath, Format format)
+{
+	//The image was edited after the container was made, a missing image is fine, the container replaces it
+	std::error_code error{};
+	const auto containerTime{ std::filesystem::last_write_time(path, error) };
+
+	if (error)
+		return nullptr;
+
+	const auto imageTime{ std::filesystem::last_write_time(imagePath, error) };
+
+	if (!error && imageTime > containerTime)
+		return nullptr;
+
+
+	HANDLE fileHandle{ CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr) };
+
+	if (fileHandle == INVALID_HANDLE_VALUE)
+		return nullptr;
+
+	LARGE_INTEGER fileSize{};
+
+	if (!GetFileSizeEx(fileHandle, &fileSize) || fileSize.QuadPart < static_cast<long long>(sizeof(Header)))
+	{
+		CloseHandle(fileHandle);
+		return nullptr;
+	}
+
+	//The view keeps the mapping and the file alive, both handles can go right away
+	HANDLE mappingHandle{ CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr) };
+	CloseHandle(fileHandle);
+
+	if (!mappingHandle)
+		return nullptr;
+
+	const void* pView{ MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0) };
+	CloseHandle(mappingHandle);
+
+	if (!pView)
+		return nullptr;
+
+	TextureContainer* pContainer{ new TextureContainer{} };
+	pContainer->m_pMappedView = pView;
+	pContainer->m_pData = static_cast<const uint8_t*>(pView);
+	pContainer->m_Size = static_cast<size_t>(fileSize.QuadPart);
+
+	if (!pContainer->IsValid())
+	{
+		std::wcout << L"Texture container is invalid!\n";
+		delete pContainer;
+		return nullptr;
+	}
+
+	//Made for another use of the image
+	if (pContainer->GetFormat() != GetStoredFormat(format, pContainer->GetHeader().width, pContainer->GetHeader().height))
+	{
+		delete pContainer;
+		return nullptr;
+	}
+
+	pContainer->ComputeContentHash();
+
+	return pContainer;
+}
+
+dae::TextureContainer* dae::TextureContainer::Create(SDL_Surface* pSurface, Format format)
+{
+	SDL_Surface* pRGBASurface{ SDL_ConvertSurfaceFormat(pSurface, SDL_PIXELFORMAT_ABGR8888, 0) };
+
+	if (!pRGBASurface)
+		return nullptr;
+
+	const uint32_t width{ static_cast<uint32_t>(pRGBASurface->w) };
+	const uint32_t height{ static_cast<uint32_t>(pRGBASurface->h) };
+
+	Header header{};
+	std::memcpy(header.magic, "DTEX", sizeof(header.magic));
+	header.version = m_Version;
+	header.width = width;
+	header.height = height;
+	header.format = static_cast<uint32_t>(GetStoredFormat(format, width, height));
+
+	//Down to 1x1
+	header.mipCount = 1;
+
+	while (header.mipCount < m_MaxMipCount && ((width >> header.mipCount) > 0 || (height >> header.mipCount) > 0))
+		++header.mipCount;
+
+
+	//The surface rows can be padded, the mip rows are not
+	std::vector<std::vector<uint32_t>> mips(header.mipCount);
+	mips[0].resize(width * height);
+
+	for (uint32_t y{}; y < height; ++y)
+		std::memcpy(mips[0].data() + y * width, static_cast<const uint8_t*>(pRGBASurface->pixels) + y * pRGBASurface->pitch, width * sizeof(uint32_t));
+
+	SDL_FreeSurface(pRGBASurface);
+
+	//Read from the converted texels, paletted images with a transparent color key or palette alpha have no Amask
+	header.hasAlpha = std::any_of(mips[0].begin(), mips[0].end(),
+		[](uint32_t texel) { return reinterpret_cast<const uint8_t*>(&texel)[3] != 255; });
+
+	//Every level is the 2x2 box average of the one above, the last row or column is reused on odd sizes
+	for (uint32_t mipLevel{ 1 }; mipLevel < header.mipCount; ++mipLevel)
+	{
+		const uint32_t sourceWidth{ std::max(width >> (mipLevel - 1), 1u) };
+		const uint32_t sourceHeight{ std::max(height >> (mipLevel - 1), 1u) };
+		const uint32_t mipWidth{ std::max(width >> mipLevel, 1u) };
+		const uint32_t mipHeight{ std::max(height >> mipLevel, 1u) };
+
+		const uint8_t* pSource{ reinterpret_cast<const uint8_t*>(mips[mipLevel - 1].data()) };
+
+		mips[mipLevel].resize(mipWidth * mipHeight);
+		uint8_t* pDestination{ reinterpret_cast<uint8_t*>(mips[mipLevel].data()) };
+
+		for (uint32_t y{}; y < mipHeight; ++y)
+		{
+			const uint32_t sourceY0{ std::min(y * 2, sourceHeight - 1) };
+			const uint32_t sourceY1{ std::min(y * 2 + 1, sourceHeight - 1) };
+
+			for (uint32_t x{}; x < mipWidth; ++x)
+			{
+				const uint32_t sourceX0{ std::min(x * 2, sourceWidth - 1) };
+				const uint32_t sourceX1{ std::min(x * 2 + 1, sourceWidth - 1) };
+
+				for (uint32_t channel{}; channel < 4; ++channel)
+				{
+					const uint32_t sum{ static_cast<uint32_t>(pSource[(sourceX0 + sourceY0 * sourceWidth) * 4 + channel])
+						+ pSource[(sourceX1 + sourceY0 * sourceWidth) * 4 + channel]
+						+ pSource[(sourceX0 + sourceY1 * sourceWidth) * 4 + channel]
+						+ pSource[(sourceX1 + sourceY1 * sourceWidth) * 4 + channel] };
+
+					pDestination[(x + y * mipWidth) * 4 + channel] = static_cast<uint8_t>((sum + 2) / 4);
+				}
+			}
+		}
+	}
+
+
+	uint32_t size{ sizeof(Header) };
+
+	for (uint32_t mipLevel{}; mipLevel < header.mipCount; ++mipLevel)
+	{
+		size = (size + m_DataAlignment - 1) / m_DataAlignment * m_DataAlignment;
+		header.mipOffsets[mipLevel] = size;
+
+		size += GetDataSize(header, static_cast<int>(mipLevel));
+	}
+
+	TextureContainer* pContainer{ new TextureContainer{} };
+	pContainer->m_OwnedData.assign(size, 0);
+	pContainer->m_pData = pContainer->m_OwnedData.data();
+	pContainer->m_Size = size;
+
+	uint8_t* pData{ pContainer->m_OwnedData.data() };
+	std::memcpy(pData, &header, sizeof(Header));
+
+	const Format storedFormat{ static_cast<Format>(header.format) };
+
+	for (uint32_t mipLevel{}; mipLevel < header.mipCount; ++mipLevel)
+	{
+		uint8_t* pMipData{ pData + header.mipOffsets[mipLevel] };
+
+		if (storedFormat == Format::RGBA8)
+		{
+			std::memcpy(pMipData, mips[mipLevel].data(), mips[mipLevel].size() * sizeof(uint32_t));
+			continue;
+		}
+
+		//Blocks overhanging the small mips repeat the last row and column
+		const uint32_t mipWidth{ std::max(width >> mipLevel, 1u) };
+		const uint32_t mipHeight{ std::max(height >> mipLevel, 1u) };
+		const uint32_t nrBlocksX{ (mipWidth + 3) / 4 };
+		const uint32_t nrBlocksY{ (mipHeight + 3) / 4 };
+
+		for (uint32_t blockY{}; blockY < nrBlocksY; ++blockY)
+		{
+			for (uint32_t blockX{}; blockX < nrBlocksX; ++blockX)
+			{
+				uint32_t texels[16]{};
+
+				for (uint32_t texel{}; texel < 16; ++texel)
+				{
+					const uint32_t x{ std::min(blockX * 4 + texel % 4, mipWidth - 1) };
+					const uint32_t y{ std::min(blockY * 4 + texel / 4, mipHeight - 1) };
+
+					texels[texel] = mips[mipLevel][x + y * mipWidth];
+				}
+
+				uint8_t* pBlock{ pMipData + (blockX + blockY * nrBlocksX) * GetBlockSize(storedFormat) };
+
+				switch (storedFormat)
+				{
+				case Format::BC1:
+					BlockCompression::EncodeBC1(texels, pBlock);
+					break;
+				case Format::BC3:
+					BlockCompression::EncodeBC3(texels, pBlock);
+					break;
+				case Format::BC5:
+					BlockCompression::EncodeBC5(texels, pBlock);
+					break;
+				}
+			}
+		}
+	}
+
+	pContainer->ComputeContentHash();
+
+	return pContainer;
+}
+
+bool dae::TextureContainer::Save(const std::string& path) const
+{
+	//Written aside and moved in place, other processes never map a half written file
+	const std::string temporaryPath{ path + ".tmp" };
+
+	{
+		std::ofstream file{ temporaryPath, std::ios::binary | std::ios::trunc };
+
+		if (!file)
+			return false;
+
+		file.write(reinterpret_cast<const char*>(m_pData), static_cast<std::streamsize>(m_Size));
+
+		if (!file)
+			return false;
+	}
+
+	std::error_code error{};
+	std::filesystem::rename(temporaryPath, path, error);
+
+	if (error)
+	{
+		std::filesystem::remove(temporaryPath, error);
+		return false;
+	}
+
+	return true;
+}
+
+int dae::TextureContainer::GetWidth(int mipLevel) const
+{
+	return std::max(static_cast<int>(GetHeader().width >> mipLevel), 1);
+}
+
+int dae::TextureContainer::GetHeight(int mipLevel) const
+{
+	return std::max(static_cast<int>(GetHeader().height >> mipLevel), 1);
+}
+
+int dae::TextureContainer::GetMipCount() const
+{
+	return static_cast<int>(GetHeader().mipCount);
+}
+
+dae::TextureContainer::Format dae::TextureContainer::GetFormat() const
+{
+	return static_cast<Format>(GetHeader().format);
+}
+
+const uint8_t* dae::TextureContainer::GetData(int mipLevel) const
+{
+	return m_pData + GetHeader().mipOffsets[mipLevel];
+}
+
+uint32_t dae::TextureContainer::GetRowPitch(int mipLevel) const
+{
+	return GetRowPitch(GetHeader(), mipLevel);
+}
+
+uint32_t dae::TextureContainer::GetDataSize(int mipLevel) const
+{
+	return GetDataSize(GetHeader(), mipLevel);
+}
+
+uint32_t dae::TextureContainer::GetRowPitch(const Header& header, int mipLevel)
+{
+	const Format format{ static_cast<Format>(header.format) };
+	const uint32_t width{ std::max(header.width >> mipLevel, 1u) };
+
+	if (!IsBlockCompressed(format))
+		return width * sizeof(uint32_t);
+
+	return (width + 3) / 4 * GetBlockSize(format);
+}
+
+uint32_t dae::TextureContainer::GetDataSize(const Header& header, int mipLevel)
+{
+	const uint32_t height{ std::max(header.height >> mipLevel, 1u) };
+
+	if (!IsBlockCompressed(static_cast<Format>(header.format)))
+		return GetRowPitch(header, mipLevel) * height;
+
+	return GetRowPitch(header, mipLevel) * ((height + 3) / 4);
+}
+
+bool dae::TextureContainer::HasAlpha() const
+{
+	return GetHeader().hasAlpha != 0;
+}
+
+uint64_t dae::TextureContainer::GetContentHash() const
+{
+	return m_ContentHash;
+}
+
+bool dae::TextureContainer::HasSameContent(const TextureContainer& other) const
+{
+	if (GetWidth() != other.GetWidth() || GetHeight() != other.GetHeight() || GetFormat() != other.GetFormat())
+		return false;
+
+	return std::memcmp(GetData(), other.GetData(), GetDataSize()) == 0;
+}
+
+void dae::TextureContainer::ComputeContentHash()
+{
+	//FNV-1a
+	constexpr uint64_t prime{ 1099511628211ull };
+	uint64_t hash{ 14695981039346656037ull };
+
+	const auto hashValue = [&](uint64_t value)
+		{
+			hash ^= value;
+			hash *= prime;
+		};
+
+	hashValue(static_cast<uint64_t>(GetWidth()));
+	hashValue(static_cast<uint64_t>(GetHeight()));
+	hashValue(static_cast<uint64_t>(GetFormat()));
+
+	const uint8_t* pData{ GetData() };
+	const size_t dataSize{ GetDataSize() };
+
+	size_t byteIndex{};
+
+	for (; byteIndex + 8 <= dataSize; byteIndex += 8)
+	{
+		uint64_t value{};
+		std::memcpy(&value, pData + byteIndex, sizeof(value));
+		hashValue(value);
+	}
+
+	for (; byteIndex < dataSize; ++byteIndex)
+		hashValue(pData[byteIndex]);
+
+	m_ContentHash = hash;
+}
+
+bool dae::TextureContainer::IsBlockCompressed(Format format)
+{
+	return format != Format::RGBA8;
+}
+
+uint32_t dae::TextureContainer::GetBlockSize(Format format)
+{
+	return format == Format::BC1 ? 8 : 16;
+}
+
+const dae::TextureContainer::Header& dae::TextureContainer::GetHeader() const
+{
+	return *reinterpret_cast<const Header*>(m_pData);
+}
+
+bool dae::TextureContainer::IsValid() const
+{
+	if (m_Size < sizeof(Header))
+		return false;
+
+	const Header& header{ GetHeader() };
+
+	if (std::memcmp(header.magic, "DTEX", sizeof(header.magic)) != 0 || header.version != m_Version)
+		return false;
+
+	if (header.width == 0 || header.height == 0 || header.mipCount == 0 || header.mipCount > m_MaxMipCount)
+		return false;
+
+	if (header.format > static_cast<uint32_t>(Format::BC5))
+		return false;
+
+	for (uint32_t mipLevel{}; mipLevel < header.mipCount; ++mipLevel)
+	{
+		if (header.mipOffsets[mipLevel] % alignof(uint32_t) != 0 || static_cast<uint64_t>(header.mipOffsets[mipLevel]) + GetDataSize(mipLevel) > m_Size)
+			return false;
+	}
+
+	return true;
+}
+
+dae::TextureContainer::Format dae::TextureContainer::GetStoredFormat(Format format, uint32_t width, uint32_t height)
+{
+	//D3D needs whole blocks on the top level
+	if (IsBlockCompressed(format) && (width % 4 != 0 || height % 4 != 0))
+		return Format::RGBA8;
+
+	return format;
+}
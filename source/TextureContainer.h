@@ -0,0 +1,108 @@
+#pragma once
+#include <string>
+#include <vector>
+
+
+namespace dae
+{
+	// Pre-decoded texture with its full mip chain, made once from an image and mapped straight from disk afterwards
+	// The mips are RGBA8 texels or BC blocks, both are uploaded to D3D and sampled on the CPU as they are stored
+	// Mapped files are read-only and shared, every process that opens the same container uses the same pages
+	class TextureContainer final
+	{
+	public:
+
+		enum class Format : uint32_t
+		{
+			RGBA8,
+
+			// 4x4 texel blocks, 4 bits per texel without alpha, 8 with interpolated alpha, 8 for two channels (normal maps)
+			BC1,
+			BC3,
+			BC5
+		};
+
+		~TextureContainer();
+
+		TextureContainer(const TextureContainer&) = delete;
+		TextureContainer(TextureContainer&&) noexcept = delete;
+		TextureContainer& operator=(const TextureContainer&) = delete;
+		TextureContainer& operator=(TextureContainer&&) noexcept = delete;
+
+		// Where the container for an image is kept, one per format so loads of the same image in other formats keep their own
+		static std::string GetContainerPath(const std::string& imagePath, Format format);
+
+		// Maps the container, nullptr when it is missing, invalid, older than the image it was made from or in another format
+		static TextureContainer* Load(const std::string& path, const std::string& imagePath, Format format);
+
+		// Converts a decoded image in memory, Save writes it out for the next run
+		// Block formats fall back to RGBA8 for images D3D can not compress, with sides that are no multiple of 4
+		static TextureContainer* Create(SDL_Surface* pSurface, Format format);
+		bool Save(const std::string& path) const;
+
+		int GetWidth(int mipLevel = 0) const;
+		int GetHeight(int mipLevel = 0) const;
+		int GetMipCount() const;
+
+		Format GetFormat() const;
+
+		// Tightly packed rows, of R, G, B, A bytes per texel or of 4x4 blocks
+		const uint8_t* GetData(int mipLevel = 0) const;
+		uint32_t GetRowPitch(int mipLevel = 0) const;
+		uint32_t GetDataSize(int mipLevel = 0) const;
+
+		// False when every alpha of the image is 255
+		bool HasAlpha() const;
+
+		// Hash of the size, format and stored top mip, the other mips follow from it
+		uint64_t GetContentHash() const;
+
+		// Byte comparison of what GetContentHash covers, hashes of different images can collide
+		bool HasSameContent(const TextureContainer& other) const;
+
+		static bool IsBlockCompressed(Format format);
+
+		// Bytes per 4x4 block
+		static uint32_t GetBlockSize(Format format);
+
+	private:
+
+		static constexpr uint32_t m_Version{ 3 };
+		static constexpr int m_MaxMipCount{ 16 };
+		static constexpr uint32_t m_DataAlignment{ 16 };
+
+		struct Header
+		{
+			char magic[4];
+			uint32_t version;
+			uint32_t width;
+			uint32_t height;
+			uint32_t mipCount;
+			uint32_t hasAlpha;
+			uint32_t format;
+			uint32_t mipOffsets[m_MaxMipCount];
+		};
+
+		TextureContainer() = default;
+
+		// Either the mapped view of the file or m_OwnedData
+		const uint8_t* m_pData{ nullptr };
+		size_t m_Size{};
+
+		const void* m_pMappedView{ nullptr };
+		std::vector<uint8_t> m_OwnedData{};
+
+		uint64_t m_ContentHash{};
+		void ComputeContentHash();
+
+		const Header& GetHeader() const;
+		bool IsValid() const;
+
+		// Sizes a header describes, also usable before the data it belongs to exists
+		static uint32_t GetRowPitch(const Header& header, int mipLevel);
+		static uint32_t GetDataSize(const Header& header, int mipLevel);
+
+		// What Create stores for a requested format
+		static Format GetStoredFormat(Format format, uint32_t width, uint32_t height);
+	};
+}
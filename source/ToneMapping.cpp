@@ -0,0 +1,91 @@
+#include "pch.h"
+#include "ToneMapping.h"
+
+#include <emmintrin.h>
+
+
+dae::ToneMapper::ToneMapper()
+	: m_Lut(m_LutSize)
+{
+}
+
+void dae::ToneMapper::Build(Operator op, float exponent)
+{
+	for (int i{}; i < m_LutSize; ++i)
+	{
+		const float t{ static_cast<float>(i) / (m_LutSize - 1) };
+		const float x{ t * t * m_MaxInput };
+
+		float mapped{};
+
+		switch (op)
+		{
+		case Operator::Gamma:
+			mapped = x;
+			break;
+		case Operator::Reinhard:
+			mapped = Reinhard(x);
+			break;
+		case Operator::Filmic:
+			mapped = Hable(x);
+			break;
+		case Operator::ACES:
+			mapped = ACESFitted(x);
+			break;
+		}
+
+		m_Lut[i] = Saturate(std::pow(Saturate(mapped), exponent));
+	}
+}
+
+dae::ColorRGB dae::ToneMapper::Map(const ColorRGB& color) const
+{
+	const __m128 invMaxInput{ _mm_set1_ps(1.f / m_MaxInput) };
+	const __m128 lutScale{ _mm_set1_ps(static_cast<float>(m_LutSize - 1)) };
+
+	__m128 channels{ _mm_loadu_ps(&color.r) };
+	channels = _mm_min_ps(_mm_max_ps(_mm_mul_ps(channels, invMaxInput), _mm_setzero_ps()), _mm_set1_ps(1.f));
+	channels = _mm_mul_ps(_mm_sqrt_ps(channels), lutScale);
+
+	alignas(16) int32_t indices[4];
+	_mm_store_si128(reinterpret_cast<__m128i*>(indices), _mm_cvtps_epi32(channels));
+
+	return ColorRGB{ m_Lut[indices[0]], m_Lut[indices[1]], m_Lut[indices[2]] };
+}
+
+float dae::ToneMapper::Reinhard(float x)
+{
+	return x / (1.f + x);
+}
+
+float dae::ToneMapper::Hable(float x)
+{
+	// Uncharted 2 curve, normalized so the white point maps to 1
+	constexpr float A{ 0.15f };
+	constexpr float B{ 0.50f };
+	constexpr float C{ 0.10f };
+	constexpr float D{ 0.20f };
+	constexpr float E{ 0.02f };
+	constexpr float F{ 0.30f };
+	constexpr float whitePoint{ 11.2f };
+	constexpr float exposureBias{ 2.f };
+
+	const auto curve = [&](float v)
+		{
+			return ((v * (A * v + C * B) + D * E) / (v * (A * v + B) + D * F)) - E / F;
+		};
+
+	return curve(x * exposureBias) / curve(whitePoint);
+}
+
+float dae::ToneMapper::ACESFitted(float x)
+{
+	// Narkowicz fit of the ACES reference rendering transform
+	constexpr float a{ 2.51f };
+	constexpr float b{ 0.03f };
+	constexpr float c{ 2.43f };
+	constexpr float d{ 0.59f };
+	constexpr float e{ 0.14f };
+
+	return Saturate((x * (a * x + b)) / (x * (c * x + d) + e));
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+
+namespace dae
+{
+	class ToneMapper final
+	{
+	public:
+
+		enum class Operator
+		{
+			Gamma,
+			Reinhard,
+			Filmic,
+			ACES
+		};
+
+		ToneMapper();
+
+		// Bakes the operator and the output exponent into one lookup table
+		void Build(Operator op, float exponent);
+
+		// Maps the rgb channels of a linear color to display values in [0, 1]
+		ColorRGB Map(const ColorRGB& color) const;
+
+		static float Reinhard(float x);
+		static float Hable(float x);
+		static float ACESFitted(float x);
+
+	private:
+
+		// The table is indexed by sqrt(x / m_MaxInput), which spends more entries on the dark range
+		static constexpr int m_LutSize{ 4096 };
+		static constexpr float m_MaxInput{ 16.f };
+
+		std::vector<float> m_Lut;
+	};
+}
@@ -0,0 +1,136 @@
+#include "pch.h"
+#include "TriangleSorter.h"
+#include "Mesh.h"
+
+#include <ppl.h>
+
+
+void dae::TriangleSorter::SortBackToFront(const Mesh& mesh, const std::vector<uint32_t>& indices, const Matrix& worldViewMatrix, std::vector<uint32_t>& sortedIndices)
+{
+	const int nrTriangles{ static_cast<int>(indices.size() / 3) };
+
+	sortedIndices.resize(nrTriangles * 3);
+
+	if (nrTriangles == 0)
+		return;
+
+
+	//View depth per vertex, so shared vertices are only transformed once
+	m_ViewDepths.resize(mesh.GetVertexCount());
+
+	concurrency::parallel_for(0, static_cast<int>(mesh.GetVertexCount()),
+		[&](int vertexIdx)
+		{
+			m_ViewDepths[vertexIdx] = worldViewMatrix.TransformPoint(mesh.GetPosition(vertexIdx)).z;
+		});
+
+
+	//The sum of the three depths orders the same as the centroid depth
+	m_Triangles.resize(nrTriangles);
+	m_Keys.resize(nrTriangles);
+
+	float minDepth{ FLT_MAX };
+	float maxDepth{ -FLT_MAX };
+
+	for (int triangleIdx{}; triangleIdx < nrTriangles; ++triangleIdx)
+	{
+		const float depth{ m_ViewDepths[indices[triangleIdx * 3]] + m_ViewDepths[indices[triangleIdx * 3 + 1]] + m_ViewDepths[indices[triangleIdx * 3 + 2]] };
+
+		minDepth = std::min(minDepth, depth);
+		maxDepth = std::max(maxDepth, depth);
+	}
+
+	const float depthRange{ maxDepth - minDepth };
+	const float depthToKey{ depthRange > FLT_EPSILON ? 0xFFFF / depthRange : 0.f };
+
+	concurrency::parallel_for(0, nrTriangles,
+		[&](int triangleIdx)
+		{
+			const float depth{ m_ViewDepths[indices[triangleIdx * 3]] + m_ViewDepths[indices[triangleIdx * 3 + 1]] + m_ViewDepths[indices[triangleIdx * 3 + 2]] };
+
+			// Ascending keys with the furthest triangle at 0
+			m_Keys[triangleIdx] = static_cast<uint16_t>((maxDepth - depth) * depthToKey);
+			m_Triangles[triangleIdx] = static_cast<uint32_t>(triangleIdx);
+		});
+
+
+	RadixSort();
+
+
+	concurrency::parallel_for(0, nrTriangles,
+		[&](int sortedIdx)
+		{
+			const uint32_t triangleIdx{ m_Triangles[sortedIdx] };
+
+			sortedIndices[sortedIdx * 3] = indices[triangleIdx * 3];
+			sortedIndices[sortedIdx * 3 + 1] = indices[triangleIdx * 3 + 1];
+			sortedIndices[sortedIdx * 3 + 2] = indices[triangleIdx * 3 + 2];
+		});
+}
+
+void dae::TriangleSorter::RadixSort()
+{
+	const int nrElements{ static_cast<int>(m_Keys.size()) };
+	const int nrChunks{ (nrElements + m_ChunkSize - 1) / m_ChunkSize };
+
+	m_KeysTemp.resize(nrElements);
+	m_TrianglesTemp.resize(nrElements);
+	m_Histograms.resize(nrChunks * m_RadixSize);
+
+
+	for (int pass{}; pass < m_NrPasses; ++pass)
+	{
+		const int shift{ pass * m_RadixBits };
+
+		//1. Every chunk counts its own digits
+		concurrency::parallel_for(0, nrChunks,
+			[&](int chunkIdx)
+			{
+				uint32_t* pHistogram{ m_Histograms.data() + chunkIdx * m_RadixSize };
+				std::fill_n(pHistogram, m_RadixSize, 0u);
+
+				const int end{ std::min(nrElements, (chunkIdx + 1) * m_ChunkSize) };
+
+				for (int elementIdx{ chunkIdx * m_ChunkSize }; elementIdx < end; ++elementIdx)
+					++pHistogram[(m_Keys[elementIdx] >> shift) & (m_RadixSize - 1)];
+			});
+
+
+		//2. Exclusive prefix sum, digit major so the chunks of one digit land next to each other in chunk order
+		uint32_t offset{};
+
+		for (int digit{}; digit < m_RadixSize; ++digit)
+		{
+			for (int chunkIdx{}; chunkIdx < nrChunks; ++chunkIdx)
+			{
+				uint32_t& count{ m_Histograms[chunkIdx * m_RadixSize + digit] };
+				const uint32_t chunkCount{ count };
+
+				count = offset;
+				offset += chunkCount;
+			}
+		}
+
+
+		//3. Scatter, every chunk writes to its own ranges which keeps the sort stable
+		concurrency::parallel_for(0, nrChunks,
+			[&](int chunkIdx)
+			{
+				uint32_t* pOffsets{ m_Histograms.data() + chunkIdx * m_RadixSize };
+
+				const int end{ std::min(nrElements, (chunkIdx + 1) * m_ChunkSize) };
+
+				for (int elementIdx{ chunkIdx * m_ChunkSize }; elementIdx < end; ++elementIdx)
+				{
+					const uint32_t destinationIdx{ pOffsets[(m_Keys[elementIdx] >> shift) & (m_RadixSize - 1)]++ };
+
+					m_KeysTemp[destinationIdx] = m_Keys[elementIdx];
+					m_TrianglesTemp[destinationIdx] = m_Triangles[elementIdx];
+				}
+			});
+
+
+		m_Keys.swap(m_KeysTemp);
+		m_Triangles.swap(m_TrianglesTemp);
+	}
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "DataTypes.h"
+
+
+namespace dae
+{
+	class Mesh;
+
+	// Reorders the triangles of an indexed triangle list back to front for alpha blending
+	// Keys are the quantized view depth of each triangle, sorted with a parallel LSD radix sort
+	class TriangleSorter final
+	{
+	public:
+		TriangleSorter() = default;
+		~TriangleSorter() = default;
+
+		TriangleSorter(const TriangleSorter&) = delete;
+		TriangleSorter(TriangleSorter&&) noexcept = delete;
+		TriangleSorter& operator=(const TriangleSorter&) = delete;
+		TriangleSorter& operator=(TriangleSorter&&) noexcept = delete;
+
+		// Writes the triangles of indices to sortedIndices, furthest from the camera first
+		void SortBackToFront(const Mesh& mesh, const std::vector<uint32_t>& indices, const Matrix& worldViewMatrix, std::vector<uint32_t>& sortedIndices);
+
+	private:
+
+		// 16 bit keys, sorted in two passes of one byte each
+		static constexpr int m_RadixBits{ 8 };
+		static constexpr int m_RadixSize{ 1 << m_RadixBits };
+		static constexpr int m_NrPasses{ 2 };
+
+		// Triangles per histogram job
+		static constexpr int m_ChunkSize{ 4096 };
+
+		// Scratch buffers, kept between frames so sorting does not allocate
+		std::vector<float> m_ViewDepths{};
+		std::vector<uint16_t> m_Keys{};
+		std::vector<uint16_t> m_KeysTemp{};
+		std::vector<uint32_t> m_Triangles{};
+		std::vector<uint32_t> m_TrianglesTemp{};
+		std::vector<uint32_t> m_Histograms{};
+
+		void RadixSort();
+	};
+}
@@ -1,5 +1,7 @@
 #pragma once
 #include <fstream>
+#include <map>
+#include <tuple>
 #include "Math.h"
 
 namespace dae
@@ -19,6 +21,10 @@ namespace dae
 			std::vector<Vector3> normals{};
 			std::vector<Vector2> UVs{};
 
+			//Faces share a vertex when they use the same position, uv and normal, instead of every corner getting its own
+			//Without that no edge is shared, which defeats the vertex cache, the LOD simplifier and the meshlet vertex limit
+			std::map<std::tuple<size_t, size_t, size_t>, uint32_t> vertexIndices{};
+
 			vertices.clear();
 			indices.clear();
 
@@ -71,6 +77,9 @@ namespace dae
 					for (size_t iFace = 0; iFace < 3; iFace++)
 					{
 						// OBJ format uses 1-based arrays
+						iTexCoord = 0;
+						iNormal = 0;
+
 						file >> iPosition;
 						vertex.position = positions[iPosition - 1];
 
@@ -95,8 +104,12 @@ namespace dae
 							}
 						}
 
-						vertices.push_back(vertex);
-						tempIndices[iFace] = uint32_t(vertices.size()) - 1;
+						const auto [vertexIt, isNewVertex] { vertexIndices.try_emplace({ iPosition, iTexCoord, iNormal }, uint32_t(vertices.size())) };
+
+						if (isNewVertex)
+							vertices.push_back(vertex);
+
+						tempIndices[iFace] = vertexIt->second;
 						//indices.push_back(uint32_t(vertices.size()) - 1);
 					}
 
@@ -0,0 +1,179 @@
+#include "pch.h"
+#include "VertexCompression.h"
+
+#include <cmath>
+
+
+namespace
+{
+	constexpr float g_MaxUnorm16{ 65535.f };
+	constexpr float g_MaxSnorm16{ 32767.f };
+
+	uint16_t QuantizeUnorm16(float value, float min, float extent)
+	{
+		if (extent <= 0.f)
+			return 0;
+
+		return static_cast<uint16_t>(std::clamp((value - min) / extent, 0.f, 1.f) * g_MaxUnorm16 + 0.5f);
+	}
+
+	int16_t QuantizeSnorm16(float value)
+	{
+		return static_cast<int16_t>(std::round(std::clamp(value, -1.f, 1.f) * g_MaxSnorm16));
+	}
+
+	//-32768 and -32767 both map to -1, like D3D reads SNORM
+	float DequantizeSnorm16(int16_t value)
+	{
+		return std::max(value / g_MaxSnorm16, -1.f);
+	}
+}
+
+
+dae::CompressedVertex dae::VertexCompression::Encode(const Vertex& vertex, const Vector3& boundsMin, const Vector3& boundsExtent)
+{
+	CompressedVertex compressedVertex{};
+
+	compressedVertex.position[0] = QuantizeUnorm16(vertex.position.x, boundsMin.x, boundsExtent.x);
+	compressedVertex.position[1] = QuantizeUnorm16(vertex.position.y, boundsMin.y, boundsExtent.y);
+	compressedVertex.position[2] = QuantizeUnorm16(vertex.position.z, boundsMin.z, boundsExtent.z);
+
+	compressedVertex.uv[0] = FloatToHalf(vertex.uv.x);
+	compressedVertex.uv[1] = FloatToHalf(vertex.uv.y);
+
+	EncodeOctahedral(vertex.normal, compressedVertex.normal);
+	EncodeOctahedral(vertex.tangent, compressedVertex.tangent);
+
+	return compressedVertex;
+}
+
+dae::Vertex dae::VertexCompression::Decode(const CompressedVertex& vertex, const Vector3& boundsMin, const Vector3& boundsExtent)
+{
+	return Vertex
+	{
+		DecodePosition(vertex, boundsMin, boundsExtent),
+		Vector2{ HalfToFloat(vertex.uv[0]), HalfToFloat(vertex.uv[1]) },
+		DecodeOctahedral(vertex.normal),
+		DecodeOctahedral(vertex.tangent)
+	};
+}
+
+dae::Vector3 dae::VertexCompression::DecodePosition(const CompressedVertex& vertex, const Vector3& boundsMin, const Vector3& boundsExtent)
+{
+	return Vector3
+	{
+		boundsMin.x + vertex.position[0] / g_MaxUnorm16 * boundsExtent.x,
+		boundsMin.y + vertex.position[1] / g_MaxUnorm16 * boundsExtent.y,
+		boundsMin.z + vertex.position[2] / g_MaxUnorm16 * boundsExtent.z
+	};
+}
+
+uint16_t dae::VertexCompression::FloatToHalf(float value)
+{
+	uint32_t bits{};
+	std::memcpy(&bits, &value, sizeof(bits));
+
+	const uint32_t sign{ (bits >> 16) & 0x8000u };
+	const uint32_t floatExponent{ (bits >> 23) & 0xFFu };
+	uint32_t mantissa{ bits & 0x7FFFFFu };
+
+	//Infinity and NaN
+	if (floatExponent == 0xFFu)
+		return static_cast<uint16_t>(sign | 0x7C00u | (mantissa ? 0x200u : 0u));
+
+	const int exponent{ static_cast<int>(floatExponent) - 127 + 15 };
+
+	if (exponent >= 31)
+		return static_cast<uint16_t>(sign | 0x7C00u);
+
+	//Subnormal half, the implicit 1 becomes explicit
+	if (exponent <= 0)
+	{
+		if (exponent < -10)
+			return static_cast<uint16_t>(sign);
+
+		mantissa |= 0x800000u;
+
+		const int shift{ 14 - exponent };
+		uint32_t half{ mantissa >> shift };
+
+		if ((mantissa >> (shift - 1)) & 1u)
+			++half;
+
+		return static_cast<uint16_t>(sign | half);
+	}
+
+	//A carry out of the mantissa correctly bumps the exponent
+	uint32_t half{ sign | (static_cast<uint32_t>(exponent) << 10) | (mantissa >> 13) };
+
+	if (mantissa & 0x1000u)
+		++half;
+
+	return static_cast<uint16_t>(half);
+}
+
+float dae::VertexCompression::HalfToFloat(uint16_t value)
+{
+	const uint32_t sign{ (value & 0x8000u) << 16 };
+	const uint32_t exponent{ (value >> 10) & 0x1Fu };
+	const uint32_t mantissa{ value & 0x3FFu };
+
+	if (exponent == 0)
+	{
+		const float subnormal{ std::ldexp(static_cast<float>(mantissa), -24) };
+		return sign ? -subnormal : subnormal;
+	}
+
+	uint32_t bits{};
+
+	if (exponent == 31)
+		bits = sign | 0x7F800000u | (mantissa << 13);
+	else
+		bits = sign | ((exponent - 15 + 127) << 23) | (mantissa << 13);
+
+	float result{};
+	std::memcpy(&result, &bits, sizeof(result));
+
+	return result;
+}
+
+void dae::VertexCompression::EncodeOctahedral(const Vector3& direction, int16_t encoded[2])
+{
+	const float length{ std::abs(direction.x) + std::abs(direction.y) + std::abs(direction.z) };
+
+	if (length <= 0.f)
+	{
+		encoded[0] = 0;
+		encoded[1] = 0;
+		return;
+	}
+
+	float x{ direction.x / length };
+	float y{ direction.y / length };
+
+	//The lower half folds over the diagonals
+	if (direction.z < 0.f)
+	{
+		const float foldedX{ (1.f - std::abs(y)) * (x >= 0.f ? 1.f : -1.f) };
+		const float foldedY{ (1.f - std::abs(x)) * (y >= 0.f ? 1.f : -1.f) };
+
+		x = foldedX;
+		y = foldedY;
+	}
+
+	encoded[0] = QuantizeSnorm16(x);
+	encoded[1] = QuantizeSnorm16(y);
+}
+
+dae::Vector3 dae::VertexCompression::DecodeOctahedral(const int16_t encoded[2])
+{
+	Vector3 direction{ DequantizeSnorm16(encoded[0]), DequantizeSnorm16(encoded[1]), 0.f };
+	direction.z = 1.f - std::abs(direction.x) - std::abs(direction.y);
+
+	const float fold{ std::max(-direction.z, 0.f) };
+
+	direction.x += direction.x >= 0.f ? -fold : fold;
+	direction.y += direction.y >= 0.f ? -fold : fold;
+
+	return direction.Normalized();
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include <cstdint>
+
+#include "DataTypes.h"
+
+
+namespace dae
+{
+	// Packing of Vertex into CompressedVertex and back, the vertex shaders decode the same layout
+	namespace VertexCompression
+	{
+		// Positions are stored as fractions of the box from boundsMin to boundsMin + boundsExtent
+		CompressedVertex Encode(const Vertex& vertex, const Vector3& boundsMin, const Vector3& boundsExtent);
+		Vertex Decode(const CompressedVertex& vertex, const Vector3& boundsMin, const Vector3& boundsExtent);
+		Vector3 DecodePosition(const CompressedVertex& vertex, const Vector3& boundsMin, const Vector3& boundsExtent);
+
+		// IEEE 754 half, rounded to nearest
+		uint16_t FloatToHalf(float value);
+		float HalfToFloat(uint16_t value);
+
+		// Unit vector folded onto an octahedron and flattened to 2 SNORM16 values (Meyer et al. 2010)
+		void EncodeOctahedral(const Vector3& direction, int16_t encoded[2]);
+		Vector3 DecodeOctahedral(const int16_t encoded[2]);
+	}
+}
@@ -44,6 +44,10 @@ int main(int argc, char* args[])
 
 
 	bool printFPS = false;
+
+	//Without changes the last frame stays on screen and the loop sleeps until an event, or a loading asset, wakes it up
+	bool skipIdleFrames = true;
+
 	//Start loop
 	pTimer->Start();
 	float printTimer = 0.f;
@@ -59,7 +63,13 @@ int main(int argc, char* args[])
 			case SDL_QUIT:
 				isLooping = false;
 				break;
+			case SDL_WINDOWEVENT:
+				pRenderer->MarkSceneChanged();
+				break;
 			case SDL_KEYUP:
+				//Every key changes a setting of the renderer
+				pRenderer->MarkSceneChanged();
+
 				//Test for a key
 				if (e.key.keysym.scancode == SDL_SCANCODE_F1)
 					pRenderer->NextRasterizerMode();
@@ -83,12 +93,47 @@ int main(int argc, char* args[])
 					pRenderer->ToggleUniformBackground();
 				else if (e.key.keysym.scancode == SDL_SCANCODE_F11)
 					printFPS = !printFPS;
+				else if (e.key.keysym.scancode == SDL_SCANCODE_F)
+					pRenderer->ToggleFXAA();
 				else if (e.key.keysym.scancode == SDL_SCANCODE_G)
 					pRenderer->ToggleColorShadingMode();
 				else if (e.key.keysym.scancode == SDL_SCANCODE_UP)
 					pRenderer->AdjustGammaCorrection(false);
 				else if (e.key.keysym.scancode == SDL_SCANCODE_DOWN)
 					pRenderer->AdjustGammaCorrection(true);
+				else if (e.key.keysym.scancode == SDL_SCANCODE_Z)
+					pRenderer->NextDepthFormat();
+				else if (e.key.keysym.scancode == SDL_SCANCODE_X)
+					pRenderer->ToggleReversedZ();
+				else if (e.key.keysym.scancode == SDL_SCANCODE_C)
+					pRenderer->ToggleDepthCompression();
+				else if (e.key.keysym.scancode == SDL_SCANCODE_V)
+					pRenderer->NextPixelLayout();
+				else if (e.key.keysym.scancode == SDL_SCANCODE_M)
+					pRenderer->ToggleMultisampling();
+				else if (e.key.keysym.scancode == SDL_SCANCODE_O)
+					pRenderer->ToggleOIT();
+				else if (e.key.keysym.scancode == SDL_SCANCODE_P)
+					pRenderer->ToggleDepthPrepass();
+				else if (e.key.keysym.scancode == SDL_SCANCODE_L)
+					pRenderer->ToggleMeshletCulling();
+				else if (e.key.keysym.scancode == SDL_SCANCODE_T)
+					pRenderer->ToggleDirtyTiles();
+				else if (e.key.keysym.scancode == SDL_SCANCODE_K)
+					pRenderer->ToggleOcclusionCulling();
+				else if (e.key.keysym.scancode == SDL_SCANCODE_J)
+					pRenderer->ToggleLod();
+				else if (e.key.keysym.scancode == SDL_SCANCODE_I)
+					pRenderer->ToggleVehicleCrowd();
+				else if (e.key.keysym.scancode == SDL_SCANCODE_U)
+				{
+					skipIdleFrames = !skipIdleFrames;
+
+					if (skipIdleFrames)
+						std::cout << "SKIP IDLE FRAMES : Enabled" << "\n";
+					else
+						std::cout << "SKIP IDLE FRAMES : Disabled" << "\n";
+				}
 				break;
 			default: ;
 			}
@@ -97,8 +142,11 @@ int main(int argc, char* args[])
 		//--------- Update ---------
 		pRenderer->Update(pTimer);
 
+		const bool isIdle = skipIdleFrames && !pRenderer->IsSceneChanged();
+
 		//--------- Render ---------
-		pRenderer->Render();
+		if (!isIdle)
+			pRenderer->Render();
 
 		//--------- Timer ---------
 		pTimer->Update();
@@ -108,6 +156,15 @@ int main(int argc, char* args[])
 			printTimer = 0.f;
 			std::cout << "dFPS: " << pTimer->GetdFPS() << std::endl;
 		}
+
+		//The timer is paused so the first frame after waking does not move by the time spent waiting
+		//Finished asset loads push an event as well, so nothing new can show up without one
+		if (isIdle)
+		{
+			pTimer->Stop();
+			SDL_WaitEvent(nullptr);
+			pTimer->Start();
+		}
 	}
 	pTimer->Stop();
 